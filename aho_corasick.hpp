@@ -0,0 +1,257 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	aho_corasick.hpp
+ * @brief	C++ template library of Aho-Corasick automaton built from patricia trie.
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ */
+
+#ifndef	__AHO_CORASICK_HPP__
+#define	__AHO_CORASICK_HPP__	"aho_corasick.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <type_traits>
+#include <vector>
+#include <utility>
+#include "patricia_trie.hpp"
+
+namespace ys
+{
+	/**
+	 * Aho-Corasick 法のオートマトン (読み出し専用)
+	 * @note	パトリシア木のキーの全体を1要素ずつの遷移に展開し、失敗遷移と出力遷移を加える。
+	 *			データ中に現れる全てのキーを、データの長さと報告数の和に比例する時間で列挙できる。
+	 * @note	状態は幅優先順に並べ、ある状態の遷移先は連続しており、キーの昇順に並ぶ。
+	 *			状態の数 (キーの要素数の合計程度) は 2^32 未満であること。
+	 * @note	テンプレートのパラメータは @a PatriciaTrie と同じ。
+	 */
+	template<typename KTYPE, typename LTYPE, typename VTYPE, VTYPE INVALID = ~(VTYPE)0>
+	class AhoCorasick
+	{
+	private:
+
+		typedef typename std::make_unsigned<KTYPE>::type UTYPE;	///< キーの比較に用いる型
+
+		/**
+		 * 状態
+		 * @note	初期状態 (添字0) は空の接頭辞に対応する。
+		 */
+		struct State
+		{
+			uint32_t c;	///< 先頭の遷移先の添字
+			uint32_t n;	///< 遷移先の数
+			uint32_t f;	///< 失敗遷移の遷移先 (最長の真の接尾辞に対応する状態)
+			uint32_t o;	///< 出力遷移の遷移先 (キー末端である最長の真の接尾辞に対応する状態, 0の時はなし)
+			LTYPE d;	///< 状態に対応する接頭辞の長さ
+			VTYPE v;	///< キー末端 (非末端の時は @a INVALID)
+		};
+
+		std::vector<State> s_;	///< 状態 (幅優先順)
+		std::vector<KTYPE> k_;	///< 各状態に至る遷移のキーの値 (末尾に先読み用の詰め物を置く)
+		std::vector<uint32_t> h_;	///< 初期状態からの遷移先の直接参照表 (1バイトのキーの時のみ, 0の時は遷移なし)
+
+		/**
+		 * 遷移先を探索
+		 * @param[in]	x	状態
+		 * @param[in]	k	キーの値
+		 * @return	遷移先 (遷移がない時は0)
+		 */
+		uint32_t
+		next(uint32_t x,
+			 KTYPE k) const
+			{
+				if (x == 0 && !h_.empty()) return h_[(UTYPE)k];
+
+				const State& t = s_[x];
+				if (t.n == 1) return k_[t.c] == k ? t.c : 0;
+
+				const KTYPE* keys = k_.data() + t.c;
+
+				if (t.n <= Symbols<KTYPE>::Span()) {
+					// 配列 k_ の末尾は詰め物があるので、その範囲内で先読みを許す
+					uint32_t i = Symbols<KTYPE>::Find(keys, t.n, k);
+					return i < t.n ? t.c + i : 0;
+				}
+
+				uint32_t i(0);
+				uint32_t j = t.n;
+				while (i < j) {
+					uint32_t c = (i + j) / 2;
+					if ((UTYPE)keys[c] < (UTYPE)k) i = c + 1;
+					else j = c;
+				}
+
+				return (i < t.n && keys[i] == k) ? t.c + i : 0;
+			}
+
+		/**
+		 * 遷移 (遷移がない時は失敗遷移を辿る)
+		 * @param[in]	x	状態
+		 * @param[in]	k	キーの値
+		 * @return	遷移先
+		 */
+		uint32_t
+		step(uint32_t x,
+			 KTYPE k) const
+			{
+				for (;;) {
+					uint32_t y = next(x, k);
+					if (y || x == 0) return y;
+					x = s_[x].f;
+				}
+			}
+
+	public:
+
+		/**
+		 * コンストラクタ (パトリシア木から構築)
+		 * @param[in]	trie	構築元のパトリシア木
+		 */
+		template<typename ALLOCATOR, typename COUNTER>
+		explicit
+		AhoCorasick(const PatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID, ALLOCATOR, COUNTER>& trie)
+			: s_(), k_(), h_()
+			{
+				typedef typename PatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID, ALLOCATOR, COUNTER>::template Node<KTYPE, LTYPE, VTYPE> N;
+
+				// 幅優先探索の待ち行列 (ノードとキーの全体の照合済みの長さ, 初期状態のノードは0)
+				std::vector<std::pair<const N*, LTYPE> > q(1, std::make_pair((const N*)0, (LTYPE)0));
+				State r = {0, 0, 0, 0, 0, INVALID};
+				s_.push_back(r);
+				k_.push_back((KTYPE)0);
+
+				for (size_t x(0); x < q.size(); ++x) {
+					const N* node = q[x].first;
+					const LTYPE p = q[x].second;
+					s_[x].c = (uint32_t)q.size();
+
+					if (node && p < node->l_) {
+						// キーの全体の途中
+						r.d = s_[x].d + 1;
+						r.v = p + 1 == node->l_ ? node->v_ : INVALID;
+						q.push_back(std::make_pair(node, (LTYPE)(p + 1)));
+						s_.push_back(r);
+						k_.push_back(node->d_[p]);
+					}
+					else {
+						const auto& c = node ? node->c_ : trie.head_;
+						for (uint32_t i(0), e = c.end(); i < e; ++i) {
+							const N* t = c.node_at(i);
+							if (!t) continue;
+
+							r.d = s_[x].d + 1;
+							r.v = t->l_ == 0 ? t->v_ : INVALID;
+							q.push_back(std::make_pair(t, (LTYPE)0));
+							s_.push_back(r);
+							k_.push_back(c.key_at(i));
+						}
+					}
+
+					s_[x].n = (uint32_t)(q.size() - s_[x].c);
+				}
+
+				k_.resize(k_.size() + 16, (KTYPE)0);
+
+				if (sizeof(KTYPE) == 1) {
+					h_.assign(256, 0);
+					for (uint32_t i(0); i < s_[0].n; ++i) h_[(UTYPE)k_[s_[0].c + i]] = s_[0].c + i;
+				}
+
+				// 失敗遷移・出力遷移 (幅優先順なので、遷移先は常に計算済み)
+				for (uint32_t x(0); x < (uint32_t)s_.size(); ++x) {
+					for (uint32_t y = s_[x].c, e = s_[x].c + s_[x].n; y < e; ++y) {
+						uint32_t f = x == 0 ? 0 : step(s_[x].f, k_[y]);
+						s_[y].f = f;
+						s_[y].o = s_[f].v != INVALID ? f : s_[f].o;
+					}
+				}
+			}
+
+		/**
+		 * コピー・コンストラクタ (使用禁止)
+		 */
+		AhoCorasick(const AhoCorasick<KTYPE, LTYPE, VTYPE, INVALID>&) = delete;
+
+		/**
+		 * 代入演算子 (使用禁止)
+		 */
+		AhoCorasick&
+		operator =(const AhoCorasick<KTYPE, LTYPE, VTYPE, INVALID>&) = delete;
+
+		/**
+		 * デストラクタ
+		 */
+		virtual
+		~AhoCorasick()
+			{
+				;
+			}
+
+		/**
+		 * データを走査 (データ中に現れるキーを全て報告)
+		 * @param[in]	buffer	走査対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[in]	callback	キーが現れる度に呼び出す関数 (引数は位置・キーの長さ・値, false を返すと走査を中止)
+		 * @return	報告したキーの数
+		 * @note	キーは終端の位置の順に、終端が同じキーは長い順に報告する。
+		 * @note	@a PatriciaTrie::scan (@a SCAN_ALL) と同じキーを報告するが、データを1度だけ走査する。
+		 */
+		template<typename CALLBACK>
+		size_t
+		scan(const KTYPE* buffer,
+			 size_t length,
+			 CALLBACK callback) const
+			{
+				assert(buffer || length == 0);
+
+				size_t r(0);
+				uint32_t x(0);
+
+				for (size_t i(0); i < length; ++i) {
+					x = step(x, buffer[i]);
+
+					for (uint32_t y = s_[x].v != INVALID ? x : s_[x].o; y; y = s_[y].o) {
+						const State& t = s_[y];
+						++r;
+						if (!callback(i + 1 - t.d, t.d, t.v)) return r;
+					}
+				}
+
+				return r;
+			}
+
+		/**
+		 * 状態の数を取得
+		 * @return	状態の数 (初期状態を含む)
+		 */
+		size_t
+		state_count() const
+			{
+				return s_.size();
+			}
+
+		/**
+		 * 使用している領域のバイト数を取得
+		 * @return	バイト数
+		 */
+		size_t
+		bytes() const
+			{
+				return sizeof(State) * s_.size() + sizeof(KTYPE) * k_.size() + sizeof(uint32_t) * h_.size();
+			}
+
+		/**
+		 * 値 @a INVALID を取得
+		 * @return	値 @a INVALID
+		 */
+		static VTYPE
+		InvalidValue()
+			{
+				return INVALID;
+			}
+	};
+};
+
+#endif	// __AHO_CORASICK_HPP__
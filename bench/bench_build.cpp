@@ -0,0 +1,81 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	bench_build.cpp
+ * @brief	木の構築の所要時間の計測
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include "patricia_trie.hpp"
+#include "bench_util.hpp"
+
+typedef ys::PatriciaTrie<char, unsigned int, unsigned int> Trie;
+typedef std::vector<std::pair<std::string, unsigned int> > Entries;
+
+/**
+ * キー群からの構築の所要時間を計測
+ * @param[in]	name	データの名前
+ * @param[in]	keys	登録するキー群
+ */
+static void
+Run(const char* name,
+	const std::vector<std::string>& keys)
+{
+	Entries entries;
+	for (size_t i(0); i < keys.size(); ++i) entries.push_back(std::make_pair(keys[i], (unsigned int)i));
+	std::sort(entries.begin(), entries.end());
+
+	std::string label;
+	uint64_t s(0);
+
+	{
+		bench::Timer t;
+		{
+			Trie trie;
+			for (const auto& e : entries) trie.add_key(e.first.data(), (unsigned int)e.first.size(), e.second);
+			s += trie.get_value(entries[0].first.data(), (unsigned int)entries[0].first.size());
+		}
+		label = std::string(name) + " add_key (sorted)";
+		bench::Report(label.c_str(), entries.size(), t.elapsed());
+	}
+
+	{
+		bench::Timer t;
+		{
+			Trie trie;
+			trie.build_from_sorted(entries.begin(), entries.end());
+			s += trie.get_value(entries[0].first.data(), (unsigned int)entries[0].first.size());
+		}
+		label = std::string(name) + " build_from_sorted";
+		bench::Report(label.c_str(), entries.size(), t.elapsed());
+	}
+
+	{
+		bench::Timer t;
+		{
+			Trie trie;
+			trie.build_parallel(entries.begin(), entries.end());
+			s += trie.get_value(entries[0].first.data(), (unsigned int)entries[0].first.size());
+		}
+		label = std::string(name) + " build_parallel";
+		bench::Report(label.c_str(), entries.size(), t.elapsed());
+	}
+
+	bench::sink = s;
+}
+
+/**
+ * 計測用コマンド
+ */
+int main()
+{
+	Run("short", bench::RandomKeys(500000, 4, 12, 26, 1));
+	Run("long", bench::RandomKeys(200000, 32, 128, 4, 3));
+	Run("binary", bench::RandomKeys(500000, 1, 16, 256, 5));
+
+	return 0;
+}
@@ -0,0 +1,301 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	bench_lookup.cpp
+ * @brief	キー探索の所要時間の計測
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "patricia_trie.hpp"
+#include "cached_patricia_trie.hpp"
+#include "frozen_patricia_trie.hpp"
+#include "succinct_patricia_trie.hpp"
+#include "bench_util.hpp"
+
+typedef ys::PatriciaTrie<char, unsigned int, unsigned int> Trie;
+typedef ys::FrozenPatriciaTrie<char, unsigned int, unsigned int> FrozenTrie;
+typedef ys::SuccinctPatriciaTrie<char, unsigned int, unsigned int> SuccinctTrie;
+typedef ys::CachedPatriciaTrie<char, unsigned int, unsigned int> CachedTrie;
+typedef ys::CachedPatriciaTrie<char, unsigned int, unsigned int, ~0U, ys::ArenaAllocator, ys::ThreadCounter> CountedCachedTrie;
+
+/**
+ * キー群に対する探索の所要時間を計測
+ * @param[in]	name	計測項目の名前
+ * @param[in]	trie	探索対象の木
+ * @param[in]	keys	登録済みのキー群
+ * @param[in]	queries	探索するキー群
+ * @param[in]	repeat	探索の反復回数
+ */
+template<typename TRIE>
+static void
+Measure(const std::string& name,
+		const TRIE& trie,
+		const std::vector<std::string>& keys,
+		const std::vector<std::string>& queries,
+		size_t repeat)
+{
+	std::string label;
+	uint64_t s(0);
+
+	{
+		bench::Timer t;
+		for (size_t r(0); r < repeat; ++r) {
+			for (const auto& k : keys) s += trie.get_value(k.data(), (unsigned int)k.size());
+		}
+		label = name + " get_value (hit)";
+		bench::Report(label.c_str(), keys.size() * repeat, t.elapsed());
+	}
+
+	{
+		bench::Timer t;
+		for (size_t r(0); r < repeat; ++r) {
+			for (const auto& k : queries) s += trie.get_value(k.data(), (unsigned int)k.size());
+		}
+		label = name + " get_value (random)";
+		bench::Report(label.c_str(), queries.size() * repeat, t.elapsed());
+	}
+
+	{
+		const size_t b(128);
+		std::vector<const char*> k;
+		std::vector<unsigned int> l;
+		std::vector<unsigned int> v(b);
+		for (const auto& q : keys) {
+			k.push_back(q.data());
+			l.push_back((unsigned int)q.size());
+		}
+
+		bench::Timer t;
+		for (size_t r(0); r < repeat; ++r) {
+			for (size_t i(0); i < k.size(); i += b) {
+				const size_t n = std::min(b, k.size() - i);
+				trie.get_values_batch(k.data() + i, l.data() + i, n, v.data());
+				s += v[0];
+			}
+		}
+		label = name + " get_values_batch (hit)";
+		bench::Report(label.c_str(), keys.size() * repeat, t.elapsed());
+	}
+
+	{
+		std::vector<unsigned int> v;
+		bench::Timer t;
+		for (size_t r(0); r < repeat; ++r) {
+			for (const auto& k : keys) {
+				v.clear();
+				trie.get_values(k.data(), (unsigned int)k.size(), v);
+				s += v.size();
+			}
+		}
+		label = name + " get_values";
+		bench::Report(label.c_str(), keys.size() * repeat, t.elapsed());
+	}
+
+	{
+		unsigned int v[16];
+		bench::Timer t;
+		for (size_t r(0); r < repeat; ++r) {
+			for (const auto& k : keys) s += trie.get_values(k.data(), (unsigned int)k.size(), v, 16);
+		}
+		label = name + " get_values (fixed)";
+		bench::Report(label.c_str(), keys.size() * repeat, t.elapsed());
+	}
+
+	{
+		unsigned int l(0);
+		bench::Timer t;
+		for (size_t r(0); r < repeat; ++r) {
+			for (const auto& k : queries) s += trie.get_longest_prefix(k.data(), (unsigned int)k.size(), &l) + l;
+		}
+		label = name + " get_longest_prefix";
+		bench::Report(label.c_str(), queries.size() * repeat, t.elapsed());
+	}
+
+	std::string text;	// 探索するキー群を連結したデータ (先頭1MBまで)
+	for (const auto& q : queries) {
+		if ((1 << 20) <= text.size()) break;
+		text += q;
+	}
+
+	{
+		std::vector<unsigned int> v;
+		bench::Timer t;
+		for (size_t i(0); i < text.size(); ++i) {
+			v.clear();
+			trie.get_values(text.data() + i, (unsigned int)(text.size() - i), v);
+			s += v.size();
+		}
+		label = name + " get_values (every offset)";
+		bench::Report(label.c_str(), text.size(), t.elapsed());
+	}
+
+	{
+		bench::Timer t;
+		s += trie.scan(text.data(), text.size(), [&](size_t, unsigned int, unsigned int v) { s += v; return true; });
+		label = name + " scan (all)";
+		bench::Report(label.c_str(), text.size(), t.elapsed());
+	}
+
+	{
+		bench::Timer t;
+		s += trie.scan(text.data(), text.size(), [&](size_t, unsigned int, unsigned int v) { s += v; return true; }, ys::SCAN_LONGEST);
+		label = name + " scan (longest)";
+		bench::Report(label.c_str(), text.size(), t.elapsed());
+	}
+
+	bench::sink = s;
+}
+
+/**
+ * キー群に対する探索の所要時間を計測
+ * @param[in]	name	データの名前
+ * @param[in]	keys	登録するキー群
+ * @param[in]	queries	探索するキー群
+ * @param[in]	repeat	探索の反復回数
+ */
+static void
+Run(const char* name,
+	const std::vector<std::string>& keys,
+	const std::vector<std::string>& queries,
+	size_t repeat)
+{
+	Trie trie;
+	for (size_t i(0); i < keys.size(); ++i) {
+		trie.add_key(keys[i].data(), (unsigned int)keys[i].size(), (unsigned int)i);
+	}
+
+	Measure(name, trie, keys, queries, repeat);
+
+	{
+		// 編集距離1以下の曖昧探索
+		uint64_t s(0);
+		bench::Timer t;
+		for (size_t i(0); i < 200 && i < queries.size(); ++i) {
+			s += trie.fuzzy_search(queries[i].data(), (unsigned int)queries[i].size(), 1, [&](const char*, unsigned int, unsigned int v, unsigned int) { s += v; return true; });
+		}
+		std::string label = std::string(name) + " fuzzy_search (1)";
+		bench::Report(label.c_str(), std::min((size_t)200, queries.size()), t.elapsed());
+		bench::sink = s;
+	}
+
+	{
+		// 偏った探索 (登録済みのキーのうち先頭の2000個を繰り返し探索)
+		CachedTrie cached;
+		CountedCachedTrie counted;
+		for (size_t i(0); i < keys.size(); ++i) {
+			cached.add_key(keys[i].data(), (unsigned int)keys[i].size(), (unsigned int)i);
+			counted.add_key(keys[i].data(), (unsigned int)keys[i].size(), (unsigned int)i);
+		}
+
+		const size_t h = std::min((size_t)2000, keys.size());
+		std::vector<const std::string*> hot;
+		for (size_t i(0); i < keys.size(); ++i) hot.push_back(&keys[(i * 7919) % h]);
+
+		uint64_t s(0);
+		std::string label;
+
+		{
+			bench::Timer t;
+			for (size_t r(0); r < repeat; ++r) {
+				for (const auto k : hot) s += trie.get_value(k->data(), (unsigned int)k->size());
+			}
+			label = std::string(name) + " get_value (hot)";
+			bench::Report(label.c_str(), hot.size() * repeat, t.elapsed());
+		}
+
+		{
+			bench::Timer t;
+			for (size_t r(0); r < repeat; ++r) {
+				for (const auto k : hot) s += cached.get_value(k->data(), (unsigned int)k->size());
+			}
+			label = std::string(name) + " cached get_value (hot)";
+			bench::Report(label.c_str(), hot.size() * repeat, t.elapsed());
+		}
+
+		// 命中率は計数する別の実体で求める (計測の対象には計数を含めない)
+		ys::ThreadCounter::Reset();
+		for (size_t r(0); r < repeat; ++r) {
+			for (const auto k : hot) s += counted.get_value(k->data(), (unsigned int)k->size());
+		}
+
+		const double hit = (double)ys::ThreadCounter::Get(ys::COUNT_CACHE_HIT);
+		const double all = hit + (double)ys::ThreadCounter::Get(ys::COUNT_CACHE_MISS) + (double)ys::ThreadCounter::Get(ys::COUNT_CACHE_BYPASS);
+		std::printf("%-40s %10.1f %% hit\n", (std::string(name) + " cache").c_str(), 0 < all ? 100.0 * hit / all : 0.0);
+		bench::sink = s;
+	}
+
+	FrozenTrie frozen(trie);
+	Measure(std::string(name) + " frozen", frozen, keys, queries, repeat);
+
+	{
+		// 探索するキー群の先頭1要素・2要素を接頭辞とする上位10件の補完
+		uint64_t s(0);
+		bench::Timer t;
+		for (size_t r(0); r < repeat; ++r) {
+			for (size_t i(0); i < 1000 && i < queries.size(); ++i) {
+				s += frozen.top_k(queries[i].data(), (unsigned int)(1 + i % 2), 10, [&](const char*, unsigned int, unsigned int v) { s += v; return true; });
+			}
+		}
+		std::string label = std::string(name) + " frozen top_k (10)";
+		bench::Report(label.c_str(), std::min((size_t)1000, queries.size()) * repeat, t.elapsed());
+		bench::sink = s;
+	}
+
+	{
+		// 簡潔表現 (領域の大きさは凍結した木との比較)
+		SuccinctTrie succinct(frozen);
+		uint64_t s(0);
+		std::string label;
+
+		{
+			bench::Timer t;
+			for (size_t r(0); r < repeat; ++r) {
+				for (const auto& k : keys) s += succinct.get_value(k.data(), (unsigned int)k.size());
+			}
+			label = std::string(name) + " succinct get_value (hit)";
+			bench::Report(label.c_str(), keys.size() * repeat, t.elapsed());
+		}
+
+		{
+			bench::Timer t;
+			for (size_t r(0); r < repeat; ++r) {
+				for (const auto& k : queries) s += succinct.get_value(k.data(), (unsigned int)k.size());
+			}
+			label = std::string(name) + " succinct get_value (random)";
+			bench::Report(label.c_str(), queries.size() * repeat, t.elapsed());
+		}
+
+		{
+			std::vector<unsigned int> v;
+			bench::Timer t;
+			for (size_t r(0); r < repeat; ++r) {
+				for (const auto& k : keys) {
+					v.clear();
+					succinct.get_values(k.data(), (unsigned int)k.size(), v);
+					s += v.size();
+				}
+			}
+			label = std::string(name) + " succinct get_values";
+			bench::Report(label.c_str(), keys.size() * repeat, t.elapsed());
+		}
+
+		std::printf("%-40s %10lu bytes frozen %10lu bytes succinct\n",
+					(std::string(name) + " size").c_str(), frozen.bytes(), succinct.bytes());
+		bench::sink = s;
+	}
+}
+
+/**
+ * 計測用コマンド
+ */
+int main()
+{
+	Run("short", bench::RandomKeys(200000, 4, 12, 26, 1), bench::RandomKeys(200000, 4, 12, 26, 2), 5);
+	Run("long", bench::RandomKeys(100000, 32, 128, 4, 3), bench::RandomKeys(100000, 32, 128, 4, 4), 5);
+	Run("chain", bench::ChainKeys(2000, 8), bench::ChainKeys(2000, 8), 20);
+
+	return 0;
+}
@@ -0,0 +1,456 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	bench_ops.cpp
+ * @brief	基本操作の所要時間・使用メモリの計測 (標準のコンテナとの比較)
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ * @note	計測項目毎に子プロセスで実行し、ピーク時の RSS (getrusage) を独立に計測する。
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "patricia_trie.hpp"
+#include "bench_util.hpp"
+
+/**
+ * パトリシア木の操作
+ */
+template<typename ALLOCATOR>
+class TrieOps
+{
+private:
+
+	ys::PatriciaTrie<char, unsigned int, unsigned int, ~0U, ALLOCATOR>* t_;	///< 計測対象
+
+public:
+
+	TrieOps()
+		: t_(new ys::PatriciaTrie<char, unsigned int, unsigned int, ~0U, ALLOCATOR>())
+		{
+			;
+		}
+
+	TrieOps(const TrieOps&) = delete;
+
+	TrieOps&
+	operator =(const TrieOps&) = delete;
+
+	~TrieOps()
+		{
+			destroy();
+		}
+
+	/**
+	 * キーを追加
+	 * @param[in]	k	キー
+	 * @param[in]	v	値
+	 */
+	void
+	add(const std::string& k,
+		unsigned int v)
+		{
+			t_->add_key(k.data(), (unsigned int)k.size(), v);
+		}
+
+	/**
+	 * キーを探索
+	 * @param[in]	k	キー
+	 * @return	値
+	 */
+	unsigned int
+	get(const std::string& k) const
+		{
+			return t_->get_value(k.data(), (unsigned int)k.size());
+		}
+
+	/**
+	 * 共通接頭辞探索
+	 * @param[in]	k	探索対象のデータ
+	 * @param[out]	v	接頭辞となるキーの値
+	 * @return	接頭辞となるキーの数
+	 */
+	size_t
+	prefixes(const std::string& k,
+			 std::vector<unsigned int>& v) const
+		{
+			v.clear();
+			t_->get_values(k.data(), (unsigned int)k.size(), v);
+			return v.size();
+		}
+
+	/**
+	 * キーを削除
+	 * @param[in]	k	キー
+	 * @return	値
+	 */
+	unsigned int
+	remove(const std::string& k)
+		{
+			return t_->remove_key(k.data(), (unsigned int)k.size());
+		}
+
+	/**
+	 * ノードの数を取得
+	 * @return	ノードの数
+	 */
+	size_t
+	nodes() const
+		{
+			return t_->stats().nodes;
+		}
+
+	/**
+	 * 計測対象を解放
+	 */
+	void
+	destroy()
+		{
+			delete t_;
+			t_ = 0;
+		}
+};
+
+/**
+ * 標準のコンテナの操作 (共通接頭辞探索は接頭辞毎の探索)
+ */
+template<typename MAP>
+class MapOps
+{
+private:
+
+	MAP* m_;	///< 計測対象
+
+public:
+
+	MapOps()
+		: m_(new MAP())
+		{
+			;
+		}
+
+	MapOps(const MapOps&) = delete;
+
+	MapOps&
+	operator =(const MapOps&) = delete;
+
+	~MapOps()
+		{
+			destroy();
+		}
+
+	/**
+	 * キーを追加
+	 * @param[in]	k	キー
+	 * @param[in]	v	値
+	 */
+	void
+	add(const std::string& k,
+		unsigned int v)
+		{
+			(*m_)[k] = v;
+		}
+
+	/**
+	 * キーを探索
+	 * @param[in]	k	キー
+	 * @return	値
+	 */
+	unsigned int
+	get(const std::string& k) const
+		{
+			auto it = m_->find(k);
+			return it != m_->end() ? it->second : ~0U;
+		}
+
+	/**
+	 * 共通接頭辞探索
+	 * @param[in]	k	探索対象のデータ
+	 * @param[out]	v	接頭辞となるキーの値
+	 * @return	接頭辞となるキーの数
+	 */
+	size_t
+	prefixes(const std::string& k,
+			 std::vector<unsigned int>& v) const
+		{
+			v.clear();
+			std::string p;
+			for (size_t i(0); i < k.size(); ++i) {
+				p.push_back(k[i]);
+				auto it = m_->find(p);
+				if (it != m_->end()) v.push_back(it->second);
+			}
+			return v.size();
+		}
+
+	/**
+	 * キーを削除
+	 * @param[in]	k	キー
+	 * @return	値
+	 */
+	unsigned int
+	remove(const std::string& k)
+		{
+			auto it = m_->find(k);
+			if (it == m_->end()) return ~0U;
+			unsigned int v = it->second;
+			m_->erase(it);
+			return v;
+		}
+
+	/**
+	 * ノードの数を取得
+	 * @return	ノードの数 (要素数)
+	 */
+	size_t
+	nodes() const
+		{
+			return m_->size();
+		}
+
+	/**
+	 * 計測対象を解放
+	 */
+	void
+	destroy()
+		{
+			delete m_;
+			m_ = 0;
+		}
+};
+
+/**
+ * ピーク時の RSS を取得
+ * @return	キロバイト数
+ */
+static size_t
+PeakRss()
+{
+	struct rusage u;
+	getrusage(RUSAGE_SELF, &u);
+	return (size_t)u.ru_maxrss;
+}
+
+/**
+ * 計測に用いるデータを生成する関数
+ * @param[out]	keys	登録するキー群
+ * @param[out]	queries	探索するキー群 (登録済みのキーと未登録のキーを含む)
+ */
+typedef void (*Data)(std::vector<std::string>& keys,
+					 std::vector<std::string>& queries);
+
+/**
+ * 1つのコンテナに対する各操作を計測
+ * @param[in]	name	計測項目の名前
+ * @param[in]	data	計測に用いるデータを生成する関数
+ * @note	使用メモリはキーの追加によるピーク時の RSS の増分。
+ */
+template<typename OPS>
+static void
+Measure(const std::string& name,
+		Data data)
+{
+	std::vector<std::string> keys;
+	std::vector<std::string> queries;
+	data(keys, queries);
+
+	const size_t rss = PeakRss();
+	std::string label;
+	uint64_t s(0);
+	OPS ops;
+
+	{
+		bench::Timer t;
+		for (size_t i(0); i < keys.size(); ++i) ops.add(keys[i], (unsigned int)i);
+		label = name + " add_key";
+		bench::Report(label.c_str(), keys.size(), t.elapsed());
+	}
+
+	const size_t peak = PeakRss();
+	const size_t nodes = ops.nodes();
+
+	{
+		bench::Timer t;
+		for (const auto& k : keys) s += ops.get(k);
+		label = name + " get_value (hit)";
+		bench::Report(label.c_str(), keys.size(), t.elapsed());
+	}
+
+	{
+		bench::Timer t;
+		for (const auto& k : queries) s += ops.get(k);
+		label = name + " get_value (random)";
+		bench::Report(label.c_str(), queries.size(), t.elapsed());
+	}
+
+	{
+		std::vector<unsigned int> v;
+		bench::Timer t;
+		for (const auto& k : queries) s += ops.prefixes(k, v);
+		label = name + " get_values";
+		bench::Report(label.c_str(), queries.size(), t.elapsed());
+	}
+
+	{
+		bench::Timer t;
+		for (size_t i(0); i < keys.size(); i += 2) s += ops.remove(keys[i]);
+		label = name + " remove_key (half)";
+		bench::Report(label.c_str(), (keys.size() + 1) / 2, t.elapsed());
+	}
+
+	{
+		bench::Timer t;
+		ops.destroy();
+		label = name + " destruction";
+		bench::Report(label.c_str(), keys.size() / 2, t.elapsed());
+	}
+
+	std::printf("%-40s %10lu KB peak %10lu KB used %10lu nodes\n",
+				name.c_str(), peak, peak - rss, nodes);
+
+	bench::sink = s;
+}
+
+/**
+ * 計測項目を子プロセスで実行
+ * @param[in]	name	計測項目の名前
+ * @param[in]	data	計測に用いるデータを生成する関数
+ * @return	true: 成功, false: 失敗
+ * @note	データも子プロセスで生成し、親プロセスは大きな領域を持たない。
+ */
+template<typename OPS>
+static bool
+Isolate(const std::string& name,
+		Data data)
+{
+	std::fflush(stdout);
+
+	pid_t pid = fork();
+	if (pid < 0) return false;
+	if (pid == 0) {
+		Measure<OPS>(name, data);
+		std::fflush(stdout);
+		_exit(0);
+	}
+
+	int status(0);
+	if (waitpid(pid, &status, 0) != pid) return false;
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * データ毎に各コンテナを計測
+ * @param[in]	name	データの名前
+ * @param[in]	data	計測に用いるデータを生成する関数
+ * @return	true: 成功, false: 失敗
+ */
+static bool
+Run(const char* name,
+	Data data)
+{
+	const std::string n(name);
+
+	return Isolate<TrieOps<ys::ArenaAllocator> >(n + " trie", data)
+		&& Isolate<TrieOps<ys::HeapAllocator> >(n + " trie (heap)", data)
+		&& Isolate<MapOps<std::map<std::string, unsigned int> > >(n + " std::map", data)
+		&& Isolate<MapOps<std::unordered_map<std::string, unsigned int> > >(n + " std::unordered_map", data);
+}
+
+/**
+ * 未登録のキー群の半分を登録済みのキーで置き換える
+ * @param[in]	keys	登録するキー群
+ * @param[in,out]	queries	未登録のキー群 (探索するキー群になる)
+ * @note	ピーク時の RSS を正しく計測できるように、大きな一時領域を確保しない。
+ */
+static void
+Mix(const std::vector<std::string>& keys,
+	std::vector<std::string>& queries)
+{
+	for (size_t i(0); i < queries.size(); i += 2) queries[i] = keys[(i * 7919) % keys.size()];
+}
+
+/**
+ * 短いキー (英字, 登録順は乱数)
+ * @param[out]	keys	登録するキー群
+ * @param[out]	queries	探索するキー群
+ */
+static void
+ShortData(std::vector<std::string>& keys,
+		  std::vector<std::string>& queries)
+{
+	keys = bench::RandomKeys(500000, 4, 12, 26, 1);
+	queries = bench::RandomKeys(500000, 4, 12, 26, 2);
+	Mix(keys, queries);
+}
+
+/**
+ * 短いキー (英字, 登録順は昇順)
+ * @param[out]	keys	登録するキー群
+ * @param[out]	queries	探索するキー群
+ */
+static void
+SortedData(std::vector<std::string>& keys,
+		   std::vector<std::string>& queries)
+{
+	ShortData(keys, queries);
+	std::sort(keys.begin(), keys.end());
+}
+
+/**
+ * 長いキー (4種類の文字)
+ * @param[out]	keys	登録するキー群
+ * @param[out]	queries	探索するキー群
+ */
+static void
+LongData(std::vector<std::string>& keys,
+		 std::vector<std::string>& queries)
+{
+	keys = bench::RandomKeys(200000, 32, 128, 4, 3);
+	queries = bench::RandomKeys(200000, 32, 128, 4, 4);
+	Mix(keys, queries);
+}
+
+/**
+ * 平仮名のキー (UTF-8)
+ * @param[out]	keys	登録するキー群
+ * @param[out]	queries	探索するキー群
+ */
+static void
+CjkData(std::vector<std::string>& keys,
+		std::vector<std::string>& queries)
+{
+	keys = bench::KanaKeys(300000, 1, 6, 5);
+	queries = bench::KanaKeys(300000, 1, 6, 6);
+	Mix(keys, queries);
+}
+
+/**
+ * URL のキー
+ * @param[out]	keys	登録するキー群
+ * @param[out]	queries	探索するキー群
+ */
+static void
+UrlData(std::vector<std::string>& keys,
+		std::vector<std::string>& queries)
+{
+	keys = bench::UrlKeys(300000, 2000, 7);
+	queries = bench::UrlKeys(300000, 2000, 8);
+	Mix(keys, queries);
+}
+
+/**
+ * 計測用コマンド
+ */
+int main()
+{
+	return Run("short", ShortData)
+		&& Run("short (sorted)", SortedData)
+		&& Run("long", LongData)
+		&& Run("cjk", CjkData)
+		&& Run("url", UrlData) ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	bench_scan.cpp
+ * @brief	データ中のキーの列挙の所要時間の計測
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "patricia_trie.hpp"
+#include "frozen_patricia_trie.hpp"
+#include "aho_corasick.hpp"
+#include "bench_util.hpp"
+
+typedef ys::PatriciaTrie<char, unsigned int, unsigned int> Trie;
+typedef ys::FrozenPatriciaTrie<char, unsigned int, unsigned int> FrozenTrie;
+typedef ys::AhoCorasick<char, unsigned int, unsigned int> Automaton;
+
+/**
+ * データ中のキーの列挙の所要時間を計測
+ * @param[in]	name	データの名前
+ * @param[in]	keys	登録するキー群
+ * @param[in]	text	走査するデータ
+ * @param[in]	utf8	UTF-8 の文字単位の走査も計測するか否か
+ */
+static void
+Run(const char* name,
+	const std::vector<std::string>& keys,
+	const std::string& text,
+	bool utf8 = false)
+{
+	Trie trie;
+	for (size_t i(0); i < keys.size(); ++i) {
+		trie.add_key(keys[i].data(), (unsigned int)keys[i].size(), (unsigned int)i);
+	}
+	FrozenTrie frozen(trie);
+	Automaton automaton(trie);
+
+	std::string label;
+	uint64_t s(0);
+	size_t n(0);
+
+	{
+		bench::Timer t;
+		n = trie.scan(text.data(), text.size(), [&](size_t, unsigned int, unsigned int v) { s += v; return true; });
+		label = std::string(name) + " trie scan";
+		bench::Report(label.c_str(), text.size(), t.elapsed());
+	}
+
+	if (utf8) {
+		bench::Timer t;
+		n = trie.scan<ys::Utf8>(text.data(), text.size(), [&](size_t, unsigned int, unsigned int v) { s += v; return true; });
+		label = std::string(name) + " trie scan (utf-8)";
+		bench::Report(label.c_str(), text.size(), t.elapsed());
+	}
+
+	{
+		bench::Timer t;
+		n = frozen.scan(text.data(), text.size(), [&](size_t, unsigned int, unsigned int v) { s += v; return true; });
+		label = std::string(name) + " frozen scan";
+		bench::Report(label.c_str(), text.size(), t.elapsed());
+	}
+
+	{
+		bench::Timer t;
+		n = automaton.scan(text.data(), text.size(), [&](size_t, unsigned int, unsigned int v) { s += v; return true; });
+		label = std::string(name) + " aho-corasick scan";
+		bench::Report(label.c_str(), text.size(), t.elapsed());
+	}
+
+	std::printf("%-40s %10lu matches %10lu states %10lu bytes\n",
+				name, n, automaton.state_count(), automaton.bytes());
+
+	bench::sink = s;
+}
+
+/**
+ * 計測用コマンド
+ */
+int main()
+{
+	const size_t size(8 << 20);
+
+	{
+		// 辞書の単語を含む英字の文章
+		std::vector<std::string> keys = bench::RandomKeys(20000, 3, 10, 26, 1);
+		std::string text;
+		std::vector<std::string> words = bench::RandomKeys(size / 4, 1, 6, 26, 2);
+		for (size_t i(0); text.size() < size; ++i) text += i % 4 == 0 ? keys[i % keys.size()] : words[i % words.size()];
+		Run("words", keys, text);
+	}
+
+	{
+		// 辞書の単語を含む平仮名の文章
+		std::vector<std::string> keys = bench::KanaKeys(20000, 1, 4, 3);
+		std::string text;
+		std::vector<std::string> words = bench::KanaKeys(size / 8, 1, 3, 4);
+		for (size_t i(0); text.size() < size; ++i) text += i % 4 == 0 ? keys[i % keys.size()] : words[i % words.size()];
+		Run("kana", keys, text, true);
+	}
+
+	{
+		// 長い共通接頭辞を持つキー群と、それに先頭だけ一致し続けるデータ (再探索では長さの2乗に比例)
+		std::vector<std::string> keys;
+		for (size_t i(1); i <= 8; ++i) keys.push_back(std::string(1000, 'a') + (char)('a' + i));
+		Run("adversarial", keys, std::string(size, 'a'));
+	}
+
+	return 0;
+}
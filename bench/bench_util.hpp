@@ -0,0 +1,185 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	bench_util.hpp
+ * @brief	ベンチマーク用の共通処理
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ */
+
+#ifndef	__BENCH_UTIL_HPP__
+#define	__BENCH_UTIL_HPP__	"bench_util.hpp"
+
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace bench
+{
+	/**
+	 * 経過時間の計測
+	 */
+	class Timer
+	{
+	private:
+
+		std::chrono::steady_clock::time_point s_;	///< 計測の開始時刻
+
+	public:
+
+		/**
+		 * コンストラクタ
+		 * @note	生成時に計測を開始する。
+		 */
+		Timer()
+			: s_(std::chrono::steady_clock::now())
+			{
+				;
+			}
+
+		/**
+		 * 経過時間を取得
+		 * @return	計測開始からの経過時間 (ナノ秒)
+		 */
+		double
+		elapsed() const
+			{
+				return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_).count();
+			}
+	};
+
+	/**
+	 * 最適化による計測対象の除去を防ぐための値の受け皿
+	 */
+	static volatile uint64_t sink;
+
+	/**
+	 * 計測結果を出力
+	 * @param[in]	name	計測項目の名前
+	 * @param[in]	count	操作の回数
+	 * @param[in]	ns	所要時間 (ナノ秒)
+	 */
+	inline void
+	Report(const char* name,
+		   size_t count,
+		   double ns)
+	{
+		std::printf("%-40s %10.1f ns/op %10.3f Mops/s\n",
+					name, ns / (double)count, (double)count * 1000.0 / ns);
+	}
+
+	/**
+	 * 乱数でキーの集合を生成
+	 * @param[in]	n	キーの数
+	 * @param[in]	min_length	キーの長さの最小値
+	 * @param[in]	max_length	キーの長さの最大値
+	 * @param[in]	alphabet	キーに用いる文字の種類数 (1〜256)
+	 * @param[in]	seed	乱数の種
+	 * @return	キーの集合 (重複を含みうる)
+	 */
+	inline std::vector<std::string>
+	RandomKeys(size_t n,
+			   size_t min_length,
+			   size_t max_length,
+			   unsigned int alphabet,
+			   unsigned int seed)
+	{
+		std::mt19937 g(seed);
+		std::vector<std::string> keys(n);
+
+		for (auto& k : keys) {
+			size_t l = min_length + g() % (max_length - min_length + 1);
+			k.resize(l);
+			for (auto& c : k) c = (char)(alphabet < 256 ? 'a' + g() % alphabet : g() % 256);
+		}
+
+		return keys;
+	}
+
+	/**
+	 * 乱数で平仮名 (UTF-8) のキーの集合を生成
+	 * @param[in]	n	キーの数
+	 * @param[in]	min_length	キーの文字数の最小値
+	 * @param[in]	max_length	キーの文字数の最大値
+	 * @param[in]	seed	乱数の種
+	 * @return	キーの集合 (重複を含みうる)
+	 */
+	inline std::vector<std::string>
+	KanaKeys(size_t n,
+			 size_t min_length,
+			 size_t max_length,
+			 unsigned int seed)
+	{
+		std::mt19937 g(seed);
+		std::vector<std::string> keys(n);
+		for (auto& k : keys) {
+			size_t l = min_length + g() % (max_length - min_length + 1);
+			for (size_t i(0); i < l; ++i) {
+				unsigned int c = 0x3041 + g() % 83;	// U+3041〜U+3093
+				k.push_back((char)(0xE0 | (c >> 12)));
+				k.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+				k.push_back((char)(0x80 | (c & 0x3F)));
+			}
+		}
+		return keys;
+	}
+
+	/**
+	 * 乱数で URL のキーの集合を生成
+	 * @param[in]	n	キーの数
+	 * @param[in]	hosts	ホスト名の種類数
+	 * @param[in]	seed	乱数の種
+	 * @return	キーの集合 (重複を含みうる)
+	 * @note	同じホスト名・パスの語彙を共有するので、長い共通接頭辞を持つ。
+	 */
+	inline std::vector<std::string>
+	UrlKeys(size_t n,
+			size_t hosts,
+			unsigned int seed)
+	{
+		static const char* schemes[] = {"http://", "https://"};
+		static const char* tlds[] = {".com", ".org", ".net", ".jp", ".co.jp"};
+
+		std::mt19937 g(seed);
+		std::vector<std::string> host = RandomKeys(hosts, 4, 12, 26, seed + 1);
+		std::vector<std::string> words = RandomKeys(1000, 2, 10, 26, seed + 2);
+		std::vector<std::string> keys(n);
+
+		for (size_t i(0); i < hosts; ++i) host[i] = std::string(i % 3 ? "www." : "") + host[i] + tlds[i % 5];
+
+		for (auto& k : keys) {
+			size_t h = g() % hosts;
+			h = h * h / hosts;	// 一部のホストに偏らせる
+			k = std::string(schemes[h % 2]) + host[h];
+			for (size_t d = 1 + g() % 5; 0 < d; --d) k += "/" + words[g() % words.size()];
+			if (g() % 4 == 0) k += "?id=" + std::to_string(g() % 100000);
+		}
+
+		return keys;
+	}
+
+	/**
+	 * 互いに接頭辞となる長いキーの集合を生成 (縮退した深い木になる)
+	 * @param[in]	n	キーの数
+	 * @param[in]	step	隣接するキーの長さの差
+	 * @return	キーの集合
+	 */
+	inline std::vector<std::string>
+	ChainKeys(size_t n,
+			  size_t step)
+	{
+		std::vector<std::string> keys(n);
+		std::string k;
+
+		for (size_t i(0); i < n; ++i) {
+			for (size_t j(0); j < step; ++j) k.push_back((char)('a' + (i + j) % 26));
+			keys[i] = k;
+		}
+
+		return keys;
+	}
+};
+
+#endif	// __BENCH_UTIL_HPP__
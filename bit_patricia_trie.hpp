@@ -0,0 +1,486 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	bit_patricia_trie.hpp
+ * @brief	C++ template library of bit-level patricia trie for fixed-width integer prefixes.
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ */
+
+#ifndef	__BIT_PATRICIA_TRIE_HPP__
+#define	__BIT_PATRICIA_TRIE_HPP__	"bit_patricia_trie.hpp"
+
+#include <cstdio>
+#include <cstdint>
+#include <cassert>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include "patricia_trie.hpp"
+
+namespace ys
+{
+	/**
+	 * 固定長の整数のキーをビット列として扱う方針
+	 * @note	最上位のビットを先頭 (位置0) とする。IPv4 のアドレスは uint32_t、
+	 *			IPv6 のアドレスは unsigned __int128 (対応するコンパイラのみ) をネットワーク順の値として与える。
+	 * @note	他のキーの型は、同じ静的メンバを持つ特殊化を与えれば用いることができる。
+	 */
+	template<typename KTYPE>
+	class BitKey
+	{
+		static_assert(std::is_integral<KTYPE>::value && std::is_unsigned<KTYPE>::value, "KTYPE must be an unsigned integral type.");
+
+	public:
+
+		/**
+		 * キーのビット数を取得
+		 * @return	ビット数
+		 */
+		static unsigned int
+		Bits()
+			{
+				return (unsigned int)(sizeof(KTYPE) * 8);
+			}
+
+		/**
+		 * 指定位置のビットを取得
+		 * @param[in]	k	キー
+		 * @param[in]	i	ビットの位置 (@a Bits 未満)
+		 * @return	ビットの値 (0または1)
+		 */
+		static unsigned int
+		Bit(KTYPE k,
+			unsigned int i)
+			{
+				return (unsigned int)(k >> (Bits() - 1 - i)) & 1;
+			}
+
+		/**
+		 * 先頭の指定ビット数以外を0にする
+		 * @param[in]	k	キー
+		 * @param[in]	n	残すビット数 (@a Bits 以下)
+		 * @return	先頭の @a n ビットのみを残したキー
+		 */
+		static KTYPE
+		Mask(KTYPE k,
+			 unsigned int n)
+			{
+				if (n == 0) return 0;
+				if (Bits() <= n) return k;
+				return (KTYPE)(k & ~(KTYPE)(((KTYPE)~(KTYPE)0) >> n));
+			}
+
+		/**
+		 * 2つのキーの先頭から一致するビット数を計算
+		 * @param[in]	a	キー
+		 * @param[in]	b	キー
+		 * @param[in]	n	比較するビット数の上限
+		 * @return	一致するビット数 (@a n 以下)
+		 */
+		static unsigned int
+		Common(KTYPE a,
+			   KTYPE b,
+			   unsigned int n)
+			{
+				KTYPE x = a ^ b;
+				if (!x) return n;
+
+				unsigned int c(0);
+#if	defined(__GNUC__) || defined(__clang__)
+				if (sizeof(KTYPE) <= sizeof(unsigned long long)) {
+					c = (unsigned int)__builtin_clzll((unsigned long long)x) - (unsigned int)(sizeof(unsigned long long) * 8 - Bits());
+				}
+				else {
+					while (!Bit(x, c)) ++c;
+				}
+#else
+				while (!Bit(x, c)) ++c;
+#endif
+				return c < n ? c : n;
+			}
+	};
+
+#if	defined(__SIZEOF_INT128__)
+	/**
+	 * 固定長の整数のキーをビット列として扱う方針 (128ビット)
+	 */
+	template<>
+	class BitKey<unsigned __int128>
+	{
+	private:
+
+		typedef unsigned __int128 KTYPE;	///< キーの型
+
+	public:
+
+		/**
+		 * キーのビット数を取得
+		 * @return	ビット数
+		 */
+		static unsigned int
+		Bits()
+			{
+				return 128;
+			}
+
+		/**
+		 * 指定位置のビットを取得
+		 * @param[in]	k	キー
+		 * @param[in]	i	ビットの位置 (128未満)
+		 * @return	ビットの値 (0または1)
+		 */
+		static unsigned int
+		Bit(KTYPE k,
+			unsigned int i)
+			{
+				return (unsigned int)(k >> (127 - i)) & 1;
+			}
+
+		/**
+		 * 先頭の指定ビット数以外を0にする
+		 * @param[in]	k	キー
+		 * @param[in]	n	残すビット数 (128以下)
+		 * @return	先頭の @a n ビットのみを残したキー
+		 */
+		static KTYPE
+		Mask(KTYPE k,
+			 unsigned int n)
+			{
+				if (n == 0) return 0;
+				if (128 <= n) return k;
+				return k & ~(((KTYPE)~(KTYPE)0) >> n);
+			}
+
+		/**
+		 * 2つのキーの先頭から一致するビット数を計算
+		 * @param[in]	a	キー
+		 * @param[in]	b	キー
+		 * @param[in]	n	比較するビット数の上限
+		 * @return	一致するビット数 (@a n 以下)
+		 */
+		static unsigned int
+		Common(KTYPE a,
+			   KTYPE b,
+			   unsigned int n)
+			{
+				KTYPE x = a ^ b;
+				uint64_t h = (uint64_t)(x >> 64);
+				uint64_t l = (uint64_t)x;
+				unsigned int c = h ? (unsigned int)__builtin_clzll(h) : l ? 64 + (unsigned int)__builtin_clzll(l) : 128;
+				return c < n ? c : n;
+			}
+	};
+#endif
+
+	/**
+	 * ビット単位のパトリシア木 (固定長の整数の接頭辞をキーとする)
+	 * @note	キーは整数とその先頭からのビット数 (接頭辞長) の組で、経路表の「アドレス/接頭辞長」に相当する。
+	 *			各ノードは2つの子ノードを持ち、分岐するビットの位置で区切るので、深さはキーのビット数以下に抑えられる。
+	 * @note	@a get_longest_prefix でアドレスに一致する最長の接頭辞 (最長一致) を探索する。
+	 * @note	テンプレートのパラメータ @a KTYPE には、@a BitKey が対応する符号なし整数を与えること。
+	 * @note	テンプレートのパラメータ @a VTYPE, @a INVALID, @a ALLOCATOR は @a PatriciaTrie と同じ。
+	 */
+	template<typename KTYPE, typename VTYPE, VTYPE INVALID = ~(VTYPE)0, typename ALLOCATOR = ArenaAllocator, typename TRAITS = BitKey<KTYPE> >
+	class BitPatriciaTrie
+	{
+	private:
+
+		/**
+		 * ノード
+		 */
+		struct Node
+		{
+			Node* c[2];	///< 子ノード (次のビットが0・1の時)
+			KTYPE k;	///< 接頭辞 (先頭の @a l ビット以外は0)
+			unsigned int l;	///< 接頭辞長
+			VTYPE v;	///< キー末端 (非末端の時は @a INVALID)
+		};
+
+		ALLOCATOR allocator_;	///< ノードの確保に用いるアロケータ
+		Node* root_;	///< 根 (0を許す)
+		size_t n_;	///< キーの数
+
+		/**
+		 * ノードを生成
+		 * @param[in]	key	接頭辞
+		 * @param[in]	length	接頭辞長
+		 * @param[in]	value	値 (非末端の時は @a INVALID)
+		 * @return	生成したノード
+		 */
+		Node*
+		create(KTYPE key,
+			   unsigned int length,
+			   VTYPE value)
+			{
+				Node* n = (Node*)allocator_.allocate(sizeof(Node));
+				Node t = {{0, 0}, TRAITS::Mask(key, length), length, value};
+				new((void*)n) Node(t);
+				return n;
+			}
+
+		/**
+		 * ノードを解放
+		 * @param[in]	node	解放対象のノード
+		 */
+		void
+		release(Node* node)
+			{
+				node->~Node();
+				allocator_.deallocate((void*)node, sizeof(Node));
+			}
+
+	public:
+
+		/**
+		 * コンストラクタ
+		 */
+		BitPatriciaTrie()
+			: allocator_(), root_(0), n_(0)
+			{
+				;
+			}
+
+		/**
+		 * コピー・コンストラクタ (使用禁止)
+		 */
+		BitPatriciaTrie(const BitPatriciaTrie<KTYPE, VTYPE, INVALID, ALLOCATOR, TRAITS>&) = delete;
+
+		/**
+		 * 代入演算子 (使用禁止)
+		 */
+		BitPatriciaTrie&
+		operator =(const BitPatriciaTrie<KTYPE, VTYPE, INVALID, ALLOCATOR, TRAITS>&) = delete;
+
+		/**
+		 * デストラクタ
+		 * @note	アロケータが一括解放できる時はノードを個別に解放しない。
+		 */
+		virtual
+		~BitPatriciaTrie()
+			{
+				if (ALLOCATOR::BulkRelease() || !root_) return;
+
+				std::vector<Node*> s(1, root_);
+				while (!s.empty()) {
+					Node* n = s.back();
+					s.pop_back();
+					if (n->c[0]) s.push_back(n->c[0]);
+					if (n->c[1]) s.push_back(n->c[1]);
+					release(n);
+				}
+			}
+
+		/**
+		 * キーを追加
+		 * @param[in]	key	接頭辞 (先頭の @a length ビットのみを用いる)
+		 * @param[in]	length	接頭辞長 (キーのビット数以下)
+		 * @param[in]	value	キーに対応する値
+		 * @note	引数 @a value に @a INVALID を代入しないこと。
+		 */
+		void
+		add_key(KTYPE key,
+				unsigned int length,
+				VTYPE value)
+			{
+				assert(length <= TRAITS::Bits());
+				assert(value != INVALID);
+
+				key = TRAITS::Mask(key, length);
+				Node** t = &root_;
+
+				for (;;) {
+					Node* n = *t;
+					if (!n) {
+						*t = create(key, length, value);
+						++n_;
+						return;
+					}
+
+					const unsigned int c = TRAITS::Common(n->k, key, std::min(n->l, length));
+
+					if (c < n->l) {
+						Node* p;
+						if (c == length) {
+							// 既存の接頭辞の接頭辞
+							p = create(key, length, value);
+						}
+						else {
+							// 分岐
+							p = create(key, c, INVALID);
+							p->c[TRAITS::Bit(key, c)] = create(key, length, value);
+						}
+						p->c[TRAITS::Bit(n->k, c)] = n;
+						*t = p;
+						++n_;
+						return;
+					}
+
+					if (n->l == length) {
+						// 更新
+						if (n->v == INVALID) ++n_;
+						n->v = value;
+						return;
+					}
+
+					t = &n->c[TRAITS::Bit(key, n->l)];
+				}
+			}
+
+		/**
+		 * キーを削除
+		 * @param[in]	key	接頭辞
+		 * @param[in]	length	接頭辞長
+		 * @return	キーに対応する値
+		 * @note	キーが見つからなかった場合は @a INVALID が返却される。
+		 * @note	不要になったノードは解放し、非末端で子ノードが1つのノードを残さない。
+		 */
+		VTYPE
+		remove_key(KTYPE key,
+				   unsigned int length)
+			{
+				assert(length <= TRAITS::Bits());
+
+				key = TRAITS::Mask(key, length);
+				Node** p(0);	// 親ノードの格納場所
+				Node** t = &root_;
+
+				while (*t && (*t)->l < length) {
+					Node* n = *t;
+					if (TRAITS::Common(n->k, key, n->l) < n->l) return INVALID;
+					p = t;
+					t = &n->c[TRAITS::Bit(key, n->l)];
+				}
+
+				Node* n = *t;
+				if (!n || n->l != length || n->k != key || n->v == INVALID) return INVALID;
+
+				const VTYPE r = n->v;
+				--n_;
+
+				if (n->c[0] && n->c[1]) {
+					n->v = INVALID;
+					return r;
+				}
+
+				*t = n->c[0] ? n->c[0] : n->c[1];
+				release(n);
+
+				if (!*t && p) {
+					// 非末端の親ノードに残った子ノードを親ノードの位置に上げる
+					Node* q = *p;
+					if (q->v == INVALID) {
+						*p = q->c[0] ? q->c[0] : q->c[1];
+						release(q);
+					}
+				}
+
+				return r;
+			}
+
+		/**
+		 * キーを探索 (キーに対応する値を獲得)
+		 * @param[in]	key	接頭辞
+		 * @param[in]	length	接頭辞長
+		 * @return	キーに対応する値
+		 * @note	キーが見つからなかった場合は @a INVALID が返却される。
+		 */
+		VTYPE
+		get_value(KTYPE key,
+				  unsigned int length) const
+			{
+				assert(length <= TRAITS::Bits());
+
+				key = TRAITS::Mask(key, length);
+				const Node* n = root_;
+
+				while (n && n->l < length) {
+					if (TRAITS::Common(n->k, key, n->l) < n->l) return INVALID;
+					n = n->c[TRAITS::Bit(key, n->l)];
+				}
+
+				return (n && n->l == length && n->k == key) ? n->v : INVALID;
+			}
+
+		/**
+		 * キーを探索 (最長一致)
+		 * @param[in]	key	アドレス
+		 * @param[out]	matched	一致した接頭辞長 (0を許す, 見つからなかった時は変更しない)
+		 * @return	アドレス @a key に一致する最長の接頭辞に対応する値
+		 * @note	キーが見つからなかった場合は @a INVALID が返却される。
+		 * @note	辿るノードの数はキーのビット数以下。
+		 */
+		VTYPE
+		get_longest_prefix(KTYPE key,
+						   unsigned int* matched = 0) const
+			{
+				VTYPE r(INVALID);
+				const Node* n = root_;
+
+				while (n) {
+					if (TRAITS::Common(n->k, key, n->l) < n->l) break;
+					if (n->v != INVALID) {
+						r = n->v;
+						if (matched) *matched = n->l;
+					}
+					if (n->l == TRAITS::Bits()) break;
+					n = n->c[TRAITS::Bit(key, n->l)];
+				}
+
+				return r;
+			}
+
+		/**
+		 * キーを探索 (アドレスに一致する接頭辞を全て短い順に訪問)
+		 * @param[in]	key	アドレス
+		 * @param[in]	visitor	一致する接頭辞が見つかる度に呼び出す関数 (引数は値・接頭辞長, false を返すと探索を中止)
+		 */
+		template<typename VISITOR>
+		void
+		get_values(KTYPE key,
+				   VISITOR visitor) const
+			{
+				const Node* n = root_;
+
+				while (n) {
+					if (TRAITS::Common(n->k, key, n->l) < n->l) return;
+					if (n->v != INVALID && !visitor(n->v, n->l)) return;
+					if (n->l == TRAITS::Bits()) return;
+					n = n->c[TRAITS::Bit(key, n->l)];
+				}
+			}
+
+		/**
+		 * キーを探索 (キーの有無をチェック)
+		 * @param[in]	key	接頭辞
+		 * @param[in]	length	接頭辞長
+		 * @return	true: キーが見つかった, false: 見つからなかった
+		 */
+		bool
+		find_key(KTYPE key,
+				 unsigned int length) const
+			{
+				return get_value(key, length) != INVALID;
+			}
+
+		/**
+		 * キーの数を取得
+		 * @return	キーの数
+		 */
+		size_t
+		size() const
+			{
+				return n_;
+			}
+
+		/**
+		 * 値 @a INVALID を取得
+		 * @return	値 @a INVALID
+		 */
+		static VTYPE
+		InvalidValue()
+			{
+				return INVALID;
+			}
+	};
+};
+
+#endif	// __BIT_PATRICIA_TRIE_HPP__
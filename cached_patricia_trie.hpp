@@ -0,0 +1,407 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	cached_patricia_trie.hpp
+ * @brief	C++ template library of patricia trie with direct-mapped lookup cache.
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ */
+
+#ifndef	__CACHED_PATRICIA_TRIE_HPP__
+#define	__CACHED_PATRICIA_TRIE_HPP__	"cached_patricia_trie.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <atomic>
+#include <new>
+#include <vector>
+#include "patricia_trie.hpp"
+
+namespace ys
+{
+	/**
+	 * 探索結果のキャッシュを前置したパトリシア木
+	 * @note	@a get_value の結果 (見つからなかったことを含む) をキーのハッシュ値で選ぶ1箇所 (直接マップ) に格納し、
+	 *			同じキーの探索は1つのキャッシュ・ラインの参照で済ませる。
+	 * @note	キャッシュの各要素は64バイトで、版数 (奇数の時は書き込み中) を前後に読んで一致を確かめる (seqlock)。
+	 *			探索は複数のスレッドから並行に行え、キャッシュへの格納も互いを待たない (書き込み中の要素は読み飛ばす)。
+	 * @note	@a add_key, @a remove_key は同じキーの要素を新たな結果で置き換える。
+	 *			これらの排他は @a PatriciaTrie と同じく呼び出し側が行う (探索と重ねないこと)。
+	 * @note	格納するキーの長さは @a CAPACITY 要素まで (それより長いキーは木を直接探索する)。
+	 * @note	命中・失敗の回数は @a COUNTER に数える (@a COUNT_CACHE_HIT, @a COUNT_CACHE_MISS, @a COUNT_CACHE_BYPASS)。
+	 *			既定の @a NoCounter では数えない。@a ThreadCounter を渡すとスレッド毎に数える。
+	 *			内部の木は常に @a NoCounter で実体化し、キャッシュの失敗時にも節点毎の計数を行わない。
+	 * @note	テンプレートのパラメータは @a PatriciaTrie と同じ (@a COUNTER はキャッシュの計数のみに用いる)。
+	 *			@a VTYPE は64ビット以下の整数であること。
+	 */
+	template<typename KTYPE, typename LTYPE, typename VTYPE, VTYPE INVALID = ~(VTYPE)0, typename ALLOCATOR = ArenaAllocator, typename COUNTER = NoCounter>
+	class CachedPatriciaTrie
+	{
+		static_assert(sizeof(VTYPE) <= sizeof(uint64_t), "VTYPE must not be larger than 64 bits.");
+
+	public:
+
+		typedef PatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID, ALLOCATOR, NoCounter> Trie;	///< 木の型
+
+		enum {
+			WORDS = 6,	///< キャッシュの要素毎のキーの語の数
+			CAPACITY = WORDS * sizeof(uint64_t) / sizeof(KTYPE)	///< キャッシュに格納できるキーの要素数
+		};
+
+	private:
+
+		/**
+		 * キャッシュの要素 (1つのキャッシュ・ライン)
+		 * @note	版数以外も原子変数とし、書き込み中の読み込みを未定義動作にしない (順序付けは版数で行う)。
+		 */
+		struct Slot
+		{
+			std::atomic<uint32_t> s;	///< 版数 (奇数の時は書き込み中)
+			std::atomic<uint32_t> l;	///< キーの長さ (0の時は空)
+			std::atomic<uint64_t> v;	///< 探索の結果
+			std::atomic<uint64_t> k[WORDS];	///< キー (末尾は0で詰める)
+		};
+
+		static_assert(sizeof(Slot) == 64, "Slot must fit in one cache line.");
+
+		Trie t_;	///< 木
+		void* p_;	///< キャッシュの領域
+		Slot* c_;	///< キャッシュ (64バイト境界に揃えた先頭)
+		size_t m_;	///< 要素の数から1を引いたもの (2の冪から1を引いた値)
+
+		/**
+		 * キーを語の配列に詰める
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数 (@a CAPACITY 以下)
+		 * @param[out]	w	語の配列 (要素数 @a WORDS)
+		 */
+		static void
+		Pack(const KTYPE* key,
+			 LTYPE length,
+			 uint64_t* w)
+			{
+				std::memset((void*)w, 0, sizeof(uint64_t) * WORDS);
+				std::memcpy((void*)w, (const void*)key, sizeof(KTYPE) * (size_t)length);
+			}
+
+		/**
+		 * キーのハッシュ値を計算
+		 * @param[in]	w	詰めたキー
+		 * @param[in]	length	キーの要素数
+		 * @return	ハッシュ値
+		 */
+		static uint64_t
+		Hash(const uint64_t* w,
+			 LTYPE length)
+			{
+				const size_t n = (sizeof(KTYPE) * (size_t)length + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+				uint64_t h = (uint64_t)length * 0x9E3779B97F4A7C15ULL;
+				for (size_t i(0); i < n; ++i) {
+					h = (h ^ w[i]) * 0xFF51AFD7ED558CCDULL;
+					h ^= h >> 32;
+				}
+				return h;
+			}
+
+		/**
+		 * キャッシュの要素を取得
+		 * @param[in]	w	詰めたキー
+		 * @param[in]	length	キーの要素数
+		 * @return	要素
+		 */
+		Slot&
+		slot(const uint64_t* w,
+			 LTYPE length) const
+			{
+				return c_[(size_t)Hash(w, length) & m_];
+			}
+
+		/**
+		 * キャッシュの要素に結果を格納
+		 * @param[in,out]	c	要素
+		 * @param[in]	w	詰めたキー
+		 * @param[in]	length	キーの要素数 (0の時は要素を空にする)
+		 * @param[in]	value	探索の結果
+		 * @param[in]	wait	true: 書き込み中の時は待つ, false: 書き込み中の時は格納しない
+		 */
+		static void
+		Store(Slot& c,
+			  const uint64_t* w,
+			  LTYPE length,
+			  VTYPE value,
+			  bool wait)
+			{
+				uint32_t s = c.s.load(std::memory_order_relaxed);
+				for (;;) {
+					if (s & 1) {
+						if (!wait) return;
+						s = c.s.load(std::memory_order_relaxed);
+						continue;
+					}
+					if (c.s.compare_exchange_weak(s, s + 1, std::memory_order_acquire, std::memory_order_relaxed)) break;
+				}
+				std::atomic_thread_fence(std::memory_order_release);
+
+				c.l.store((uint32_t)length, std::memory_order_relaxed);
+				c.v.store((uint64_t)value, std::memory_order_relaxed);
+				for (size_t i(0); i < WORDS; ++i) c.k[i].store(w[i], std::memory_order_relaxed);
+
+				c.s.store(s + 2, std::memory_order_release);
+			}
+
+		/**
+		 * キャッシュの要素から結果を取得
+		 * @param[in]	c	要素
+		 * @param[in]	w	詰めたキー
+		 * @param[in]	length	キーの要素数
+		 * @param[out]	value	探索の結果
+		 * @return	true: 命中した, false: 失敗した (書き込み中を含む)
+		 */
+		static bool
+		Load(const Slot& c,
+			 const uint64_t* w,
+			 LTYPE length,
+			 VTYPE& value)
+			{
+				const uint32_t s = c.s.load(std::memory_order_acquire);
+				if (s & 1) return false;
+				if (c.l.load(std::memory_order_relaxed) != (uint32_t)length) return false;
+
+				bool r(true);
+				for (size_t i(0); i < WORDS; ++i) r &= c.k[i].load(std::memory_order_relaxed) == w[i];
+				const uint64_t v = c.v.load(std::memory_order_relaxed);
+
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (!r || c.s.load(std::memory_order_relaxed) != s) return false;
+
+				value = (VTYPE)v;
+				return true;
+			}
+
+		/**
+		 * キャッシュの要素を置き換え
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @param[in]	value	新たな探索の結果
+		 */
+		void
+		update(const KTYPE* key,
+			   LTYPE length,
+			   VTYPE value)
+			{
+				if (CAPACITY < (size_t)length) return;
+
+				uint64_t w[WORDS];
+				Pack(key, length, w);
+				Store(slot(w, length), w, length, value, true);
+			}
+
+	public:
+
+		/**
+		 * コンストラクタ
+		 * @param[in]	slots	キャッシュの要素の数 (2の冪に切り上げる)
+		 */
+		explicit
+		CachedPatriciaTrie(size_t slots = 4096)
+			: t_(), p_(0), c_(0), m_(0)
+			{
+				size_t n(1);
+				while (n < slots) n <<= 1;
+
+				p_ = ::operator new(sizeof(Slot) * (n + 1));
+				c_ = (Slot*)(((uintptr_t)p_ + sizeof(Slot) - 1) & ~(uintptr_t)(sizeof(Slot) - 1));
+				m_ = n - 1;
+
+				for (size_t i(0); i < n; ++i) {
+					Slot* c = new((void*)(c_ + i)) Slot;
+					c->s.store(0, std::memory_order_relaxed);
+					c->l.store(0, std::memory_order_relaxed);
+					c->v.store(0, std::memory_order_relaxed);
+					for (size_t j(0); j < WORDS; ++j) c->k[j].store(0, std::memory_order_relaxed);
+				}
+			}
+
+		/**
+		 * コピー・コンストラクタ (使用禁止)
+		 */
+		CachedPatriciaTrie(const CachedPatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID, ALLOCATOR, COUNTER>&) = delete;
+
+		/**
+		 * 代入演算子 (使用禁止)
+		 */
+		CachedPatriciaTrie&
+		operator =(const CachedPatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID, ALLOCATOR, COUNTER>&) = delete;
+
+		/**
+		 * デストラクタ
+		 */
+		virtual
+		~CachedPatriciaTrie()
+			{
+				for (size_t i(0); i <= m_; ++i) c_[i].~Slot();
+				::operator delete(p_);
+			}
+
+		/**
+		 * キーを追加
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @param[in]	value	キー @a key に対応する値
+		 * @note	引数 @a value に @a INVALID を代入しないこと。
+		 * @note	キャッシュの同じキーの要素を新たな値で置き換える。
+		 */
+		void
+		add_key(const KTYPE* key,
+				LTYPE length,
+				VTYPE value = 0)
+			{
+				t_.add_key(key, length, value);
+				update(key, length, value);
+			}
+
+		/**
+		 * キーを削除
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	キー @a key に対応する値
+		 * @note	キーが見つからなかった場合は @a INVALID が返却される。
+		 * @note	キャッシュの同じキーの要素を、見つからなかった結果で置き換える。
+		 */
+		VTYPE
+		remove_key(const KTYPE* key,
+				   LTYPE length)
+			{
+				const VTYPE v = t_.remove_key(key, length);
+				update(key, length, INVALID);
+				return v;
+			}
+
+		/**
+		 * キーを探索 (キーに対応する値を獲得)
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	キー @a key に対応する値
+		 * @note	キーが見つからなかった場合は @a INVALID が返却される。
+		 * @note	キャッシュに失敗した時は木を探索して結果を格納する (他のスレッドが書き込み中の時は格納しない)。
+		 */
+		VTYPE
+		get_value(const KTYPE* key,
+				  LTYPE length) const
+			{
+				assert(key);
+				assert(0 < length);
+
+				if (CAPACITY < (size_t)length) {
+					COUNTER::Count(COUNT_CACHE_BYPASS);
+					return t_.get_value(key, length);
+				}
+
+				uint64_t w[WORDS];
+				Pack(key, length, w);
+				Slot& c = slot(w, length);
+
+				VTYPE v;
+				if (Load(c, w, length, v)) {
+					COUNTER::Count(COUNT_CACHE_HIT);
+					return v;
+				}
+
+				COUNTER::Count(COUNT_CACHE_MISS);
+				v = t_.get_value(key, length);
+				Store(c, w, length, v, false);
+				return v;
+			}
+
+		/**
+		 * キーを探索 (共通接頭辞探索, 接頭辞となるキーの値を全て獲得)
+		 * @param[in]	buffer	探索対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[out]	values	配列 @a buffer の接頭辞となるキーの全ての値 (短い順)
+		 * @note	キャッシュを用いない。
+		 * @note	テンプレートのパラメータ @a CODE は @a PatriciaTrie::get_values と同じ。
+		 */
+		template<typename CODE = Elements<KTYPE> >
+		void
+		get_values(const KTYPE* buffer,
+				   LTYPE length,
+				   std::vector<VTYPE>& values) const
+			{
+				t_.template get_values<CODE>(buffer, length, values);
+			}
+
+		/**
+		 * キーを探索 (共通接頭辞探索, 接頭辞となるキーを順に訪問)
+		 * @param[in]	buffer	探索対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[in]	visitor	接頭辞となるキーが見つかる度に短い順に呼び出す関数 (引数は値・キーの長さ, false を返すと探索を中止)
+		 * @note	キャッシュを用いない。
+		 * @note	テンプレートのパラメータ @a CODE は @a PatriciaTrie::get_values と同じ。
+		 */
+		template<typename CODE = Elements<KTYPE>, typename VISITOR>
+		void
+		get_values(const KTYPE* buffer,
+				   LTYPE length,
+				   VISITOR visitor) const
+			{
+				t_.template get_values<CODE>(buffer, length, visitor);
+			}
+
+		/**
+		 * キーを探索 (キーの有無をチェック)
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	true: キーが見つかった, false: 見つからなかった
+		 */
+		bool
+		find_key(const KTYPE* key,
+				 LTYPE length) const
+			{
+				return get_value(key, length) != INVALID;
+			}
+
+		/**
+		 * キャッシュを空にする
+		 * @note	@a add_key, @a remove_key と同じく探索と重ねないこと。
+		 */
+		void
+		clear_cache()
+			{
+				const uint64_t w[WORDS] = {0};
+				for (size_t i(0); i <= m_; ++i) Store(c_[i], w, 0, INVALID, true);
+			}
+
+		/**
+		 * キャッシュの要素の数を取得
+		 * @return	要素の数
+		 */
+		size_t
+		cache_size() const
+			{
+				return m_ + 1;
+			}
+
+		/**
+		 * 木を取得
+		 * @return	木
+		 * @note	キャッシュを介さない探索 (@a PatriciaTrie::scan 等) に用いる。
+		 */
+		const Trie&
+		trie() const
+			{
+				return t_;
+			}
+
+		/**
+		 * 値 @a INVALID を取得
+		 * @return	値 @a INVALID
+		 */
+		static VTYPE
+		InvalidValue()
+			{
+				return INVALID;
+			}
+	};
+};
+
+#endif	// __CACHED_PATRICIA_TRIE_HPP__
@@ -0,0 +1,697 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	concurrent_patricia_trie.hpp
+ * @brief	C++ template library of patricia trie for concurrent readers and a single writer.
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ */
+
+#ifndef	__CONCURRENT_PATRICIA_TRIE_HPP__
+#define	__CONCURRENT_PATRICIA_TRIE_HPP__	"concurrent_patricia_trie.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <new>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <algorithm>
+#include <vector>
+#include <utility>
+#include "patricia_trie_simd.hpp"
+
+/**
+ * 同時に探索できるスレッドの数の上限
+ */
+#ifndef	__CONCURRENT_PATRICIA_TRIE_THREADS__
+#define	__CONCURRENT_PATRICIA_TRIE_THREADS__	256
+#endif
+
+namespace ys
+{
+	/**
+	 * 並行に探索できるパトリシア木
+	 * @note	探索は複数のスレッドからロックなしで待ちなく (wait-free) 行える。
+	 *			キーの追加・削除はミューテックスで直列化し、変更する経路上のノードを複製してから根を差し替える。
+	 * @note	差し替えたノードは世代 (epoch) に基づいて、それを参照しうる探索が全て終わった後に解放する。
+	 * @note	探索するスレッドの数は @a __CONCURRENT_PATRICIA_TRIE_THREADS__ を超えないこと
+	 *			(超えた場合は、他のスレッドが終了するまで最初の探索が待たされる)。
+	 * @note	テンプレートのパラメータは @a PatriciaTrie と同じ。
+	 */
+	template<typename KTYPE, typename LTYPE, typename VTYPE, VTYPE INVALID = ~(VTYPE)0>
+	class ConcurrentPatriciaTrie
+	{
+		static_assert(std::is_integral<KTYPE>::value, "KTYPE must be an integral type.");
+
+	private:
+
+		typedef typename std::make_unsigned<KTYPE>::type UTYPE;	///< キーの比較に用いる型
+
+		enum {
+			THREADS = __CONCURRENT_PATRICIA_TRIE_THREADS__	///< スレッドの数の上限
+		};
+
+		/**
+		 * ノード (公開後は変更しない)
+		 * @note	直後にキーの全体、子ノードに至るキーの値 (昇順)、子ノードを続けて配置する。
+		 * @note	根は空のキーを持つ非末端ノードで、その子ノードが各キーの先頭の値に対応する。
+		 */
+		struct Node
+		{
+			uint32_t n;	///< 子ノードの数
+			LTYPE l;	///< キーの全体の長さ
+			VTYPE v;	///< キー末端 (非末端の時は @a INVALID)
+		};
+
+		/**
+		 * 探索中のスレッドの世代
+		 * @note	各要素が1つのキャッシュ・ラインを占めるよう、領域は64バイト境界に揃えて確保する。
+		 */
+		struct Slot
+		{
+			std::atomic<uint64_t> e;	///< 探索開始時の世代 (0の時は探索していない)
+			char pad[64 - sizeof(std::atomic<uint64_t>)];	///< 偽共有を避けるための詰め物
+		};
+
+		static_assert(sizeof(Slot) == 64, "Slot must fit in one cache line.");
+
+		std::atomic<const Node*> root_;	///< 根
+		std::atomic<uint64_t> epoch_;	///< 現在の世代
+		void* block_;	///< スレッド毎の世代の領域
+		Slot* slots_;	///< スレッド毎の世代 (64バイト境界に揃えた先頭)
+		std::vector<const Node*> limbo_[3];	///< 世代毎の解放待ちのノード
+		std::mutex mutex_;	///< キーの追加・削除の直列化に用いるミューテックス
+
+		/**
+		 * 探索中であることを世代とともに表明 (コンストラクタ/デストラクタで開始/終了)
+		 * @note	世代の表明・根の参照・根の差し替え・世代の確認は全て seq_cst の操作とし、
+		 *			差し替え前の根を参照する探索の世代を @a collect が必ず観測するようにする (ThreadSanitizer も扱える)。
+		 */
+		class Guard
+		{
+		private:
+
+			std::atomic<uint64_t>& e_;	///< スレッドの世代
+
+		public:
+
+			/**
+			 * コンストラクタ
+			 * @param[in,out]	trie	探索対象の木
+			 */
+			explicit
+			Guard(const ConcurrentPatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID>& trie)
+				: e_(trie.slots_[ThreadId()].e)
+				{
+					e_.store(trie.epoch_.load(std::memory_order_relaxed), std::memory_order_seq_cst);
+				}
+
+			/**
+			 * コピー・コンストラクタ (使用禁止)
+			 */
+			Guard(const Guard&) = delete;
+
+			/**
+			 * 代入演算子 (使用禁止)
+			 */
+			Guard&
+			operator =(const Guard&) = delete;
+
+			/**
+			 * デストラクタ
+			 */
+			~Guard()
+				{
+					e_.store(0, std::memory_order_release);
+				}
+		};
+
+		/**
+		 * スレッド番号の使用状況を取得
+		 * @return	スレッド番号毎の使用状況
+		 */
+		static std::atomic<bool>*
+		Used()
+			{
+				static std::atomic<bool> u[THREADS];
+				return u;
+			}
+
+		/**
+		 * 呼び出し元のスレッドの番号を取得
+		 * @return	スレッドの番号 (0以上 @a THREADS 未満)
+		 * @note	番号はスレッドの初回の呼び出しで割り当て、スレッドの終了時に返却する。
+		 */
+		static unsigned int
+		ThreadId()
+			{
+				/**
+				 * スレッド番号の保持 (スレッドの終了時に返却)
+				 */
+				struct Holder
+				{
+					unsigned int id;	///< スレッドの番号
+
+					Holder()
+						: id(0)
+						{
+							std::atomic<bool>* u = Used();
+							for (;;) {
+								for (unsigned int i(0); i < THREADS; ++i) {
+									bool f(false);
+									if (!u[i].load(std::memory_order_relaxed) && u[i].compare_exchange_strong(f, true)) {
+										id = i;
+										return;
+									}
+								}
+								std::this_thread::yield();
+							}
+						}
+
+					~Holder()
+						{
+							Used()[id].store(false, std::memory_order_release);
+						}
+				};
+
+				static thread_local Holder h;
+				return h.id;
+			}
+
+		/**
+		 * 境界に合わせてバイト数を切り上げ
+		 * @param[in]	size	バイト数
+		 * @param[in]	align	境界
+		 * @return	切り上げたバイト数
+		 */
+		static size_t
+		Round(size_t size,
+			  size_t align)
+			{
+				return (size + align - 1) / align * align;
+			}
+
+		/**
+		 * ノードのキーの全体を取得
+		 * @param[in]	x	ノード
+		 * @return	キーの全体
+		 */
+		static const KTYPE*
+		Label(const Node* x)
+			{
+				return (const KTYPE*)((const char*)x + Round(sizeof(Node), alignof(KTYPE)));
+			}
+
+		/**
+		 * ノードの子ノードに至るキーの値を取得
+		 * @param[in]	x	ノード
+		 * @return	子ノードに至るキーの値の配列
+		 */
+		static const KTYPE*
+		Keys(const Node* x)
+			{
+				return Label(x) + x->l;
+			}
+
+		/**
+		 * ノードの子ノードを取得
+		 * @param[in]	x	ノード
+		 * @return	子ノードの配列
+		 */
+		static const Node* const*
+		Children(const Node* x)
+			{
+				return (const Node* const*)((const char*)x + Round(Round(sizeof(Node), alignof(KTYPE)) + sizeof(KTYPE) * ((size_t)x->l + x->n), alignof(Node*)));
+			}
+
+		/**
+		 * ノードを生成
+		 * @param[in]	label	キーの全体
+		 * @param[in]	l	配列 @a label の要素数
+		 * @param[in]	v	キー末端
+		 * @param[in]	keys	子ノードに至るキーの値 (昇順)
+		 * @param[in]	children	子ノード
+		 * @param[in]	n	子ノードの数
+		 * @return	生成したノード
+		 */
+		static const Node*
+		Make(const KTYPE* label,
+			 LTYPE l,
+			 VTYPE v,
+			 const KTYPE* keys,
+			 const Node* const* children,
+			 uint32_t n)
+			{
+				const size_t s = Round(Round(sizeof(Node), alignof(KTYPE)) + sizeof(KTYPE) * ((size_t)l + n), alignof(Node*)) + sizeof(Node*) * n;
+				Node* x = (Node*)::operator new(s);
+				x->n = n;
+				x->l = l;
+				x->v = v;
+
+				if (0 < l) std::memcpy((void*)Label(x), (const void*)label, sizeof(KTYPE) * l);
+				if (0 < n) {
+					std::memcpy((void*)Keys(x), (const void*)keys, sizeof(KTYPE) * n);
+					std::memcpy((void*)Children(x), (const void*)children, sizeof(Node*) * n);
+				}
+
+				return x;
+			}
+
+		/**
+		 * ノードを複製 (子ノードを1つ差し替え)
+		 * @param[in]	x	複製元のノード
+		 * @param[in]	j	差し替える子ノードの位置
+		 * @param[in]	c	新たな子ノード (0の時は子ノードを除去)
+		 * @return	生成したノード
+		 */
+		static const Node*
+		Replace(const Node* x,
+				uint32_t j,
+				const Node* c)
+			{
+				assert(j < x->n);
+
+				std::vector<KTYPE> k(Keys(x), Keys(x) + x->n);
+				std::vector<const Node*> d(Children(x), Children(x) + x->n);
+				if (c) {
+					d[j] = c;
+				}
+				else {
+					k.erase(k.begin() + j);
+					d.erase(d.begin() + j);
+				}
+
+				return Make(Label(x), x->l, x->v, k.data(), d.data(), (uint32_t)d.size());
+			}
+
+		/**
+		 * ノードを複製 (子ノードを1つ追加)
+		 * @param[in]	x	複製元のノード
+		 * @param[in]	j	追加する位置
+		 * @param[in]	k	子ノードに至るキーの値
+		 * @param[in]	c	子ノード
+		 * @return	生成したノード
+		 */
+		static const Node*
+		Insert(const Node* x,
+			   uint32_t j,
+			   KTYPE k,
+			   const Node* c)
+			{
+				std::vector<KTYPE> s(Keys(x), Keys(x) + x->n);
+				std::vector<const Node*> d(Children(x), Children(x) + x->n);
+				s.insert(s.begin() + j, k);
+				d.insert(d.begin() + j, c);
+
+				return Make(Label(x), x->l, x->v, s.data(), d.data(), (uint32_t)d.size());
+			}
+
+		/**
+		 * 非末端ノードとその唯一の子ノードを統合
+		 * @param[in]	x	非末端ノード
+		 * @param[in]	k	子ノードに至るキーの値
+		 * @param[in]	c	子ノード
+		 * @return	生成したノード
+		 */
+		static const Node*
+		Merge(const Node* x,
+			  KTYPE k,
+			  const Node* c)
+			{
+				std::vector<KTYPE> l(Label(x), Label(x) + x->l);
+				l.push_back(k);
+				l.insert(l.end(), Label(c), Label(c) + c->l);
+
+				return Make(l.data(), (LTYPE)l.size(), c->v, Keys(c), Children(c), c->n);
+			}
+
+		/**
+		 * 子ノードの挿入位置を探索
+		 * @param[in]	x	親ノード
+		 * @param[in]	k	子ノードに至るキーの値
+		 * @return	キーの値が @a k 以上の最初の子ノードの位置
+		 */
+		static uint32_t
+		Lower(const Node* x,
+			  KTYPE k)
+			{
+				const KTYPE* s = Keys(x);
+				uint32_t i(0);
+				uint32_t j = x->n;
+
+				while (i < j) {
+					uint32_t c = (i + j) / 2;
+					if ((UTYPE)s[c] < (UTYPE)k) i = c + 1;
+					else j = c;
+				}
+
+				return i;
+			}
+
+		/**
+		 * 子ノードを探索
+		 * @param[in]	x	親ノード
+		 * @param[in]	k	子ノードに至るキーの値
+		 * @return	子ノード (見つからなかった時は0)
+		 */
+		static const Node*
+		Child(const Node* x,
+			  KTYPE k)
+			{
+				const uint32_t n = x->n;
+
+				if (n <= Symbols<KTYPE>::Span()) {
+					// 子ノードに至るキーの値の後ろには子ノードの配列が続くので、その範囲内で先読みを許す
+					uint32_t i = Symbols<KTYPE>::Find(Keys(x), n, k);
+					return i < n ? Children(x)[i] : 0;
+				}
+
+				uint32_t i = Lower(x, k);
+				return (i < n && Keys(x)[i] == k) ? Children(x)[i] : 0;
+			}
+
+		/**
+		 * ノードの解放を予約
+		 * @param[in]	x	公開済みで、根から辿れなくなったノード
+		 */
+		void
+		retire(const Node* x)
+			{
+				limbo_[epoch_.load(std::memory_order_relaxed) % 3].push_back(x);
+			}
+
+		/**
+		 * 世代を進め、参照されなくなったノードを解放
+		 * @note	全ての探索中のスレッドが現在の世代にある時のみ世代を進める。
+		 *			2世代前に解放を予約したノードは、どの探索からも参照されない。
+		 */
+		void
+		collect()
+			{
+				const uint64_t e = epoch_.load(std::memory_order_relaxed);
+				for (unsigned int i(0); i < THREADS; ++i) {
+					uint64_t f = slots_[i].e.load(std::memory_order_seq_cst);
+					if (f != 0 && f != e) return;
+				}
+
+				epoch_.store(e + 1, std::memory_order_seq_cst);
+
+				std::vector<const Node*>& l = limbo_[(e + 1) % 3];
+				for (auto x : l) ::operator delete((void*)x);
+				l.clear();
+			}
+
+	public:
+
+		/**
+		 * コンストラクタ
+		 */
+		ConcurrentPatriciaTrie()
+			: root_(Make(0, 0, INVALID, 0, 0, 0)), epoch_(1), block_(::operator new(sizeof(Slot) * (THREADS + 1))), slots_(0), limbo_(), mutex_()
+			{
+				slots_ = (Slot*)(((uintptr_t)block_ + sizeof(Slot) - 1) & ~(uintptr_t)(sizeof(Slot) - 1));
+
+				for (unsigned int i(0); i < THREADS; ++i) {
+					Slot* t = new((void*)(slots_ + i)) Slot;
+					t->e.store(0, std::memory_order_relaxed);
+				}
+			}
+
+		/**
+		 * コピー・コンストラクタ (使用禁止)
+		 */
+		ConcurrentPatriciaTrie(const ConcurrentPatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID>&) = delete;
+
+		/**
+		 * 代入演算子 (使用禁止)
+		 */
+		ConcurrentPatriciaTrie&
+		operator =(const ConcurrentPatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID>&) = delete;
+
+		/**
+		 * デストラクタ
+		 * @note	探索中のスレッドがないこと。
+		 */
+		virtual
+		~ConcurrentPatriciaTrie()
+			{
+				std::vector<const Node*> s(1, root_.load(std::memory_order_relaxed));
+
+				while (!s.empty()) {
+					const Node* x = s.back();
+					s.pop_back();
+					s.insert(s.end(), Children(x), Children(x) + x->n);
+					::operator delete((void*)x);
+				}
+
+				for (auto& l : limbo_) {
+					for (auto x : l) ::operator delete((void*)x);
+				}
+
+				::operator delete(block_);
+			}
+
+		/**
+		 * キーを追加
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @param[in]	value	キー @a key に対応する値
+		 * @note	引数 @a value に @a INVALID を代入しないこと。
+		 * @note	他の追加・削除とは直列化され、探索とは並行に行える。
+		 */
+		void
+		add_key(const KTYPE* key,
+				LTYPE length,
+				VTYPE value = 0)
+			{
+				assert(key);
+				assert(0 < length);
+				assert(value != INVALID);
+
+				std::lock_guard<std::mutex> lock(mutex_);
+
+				std::vector<std::pair<const Node*, uint32_t> > path;	// 経路上のノードと辿った子ノードの位置
+				std::vector<const Node*> retired;	// 差し替えるノード
+				const Node* x = root_.load(std::memory_order_relaxed);
+				const Node* b(0);	// 経路の末端の新たなノード
+				LTYPE i(0);
+
+				for (;;) {
+					if (i == length) {
+						// 更新
+						b = Make(Label(x), x->l, value, Keys(x), Children(x), x->n);
+						retired.push_back(x);
+						break;
+					}
+
+					const uint32_t j = Lower(x, key[i]);
+					if (j == x->n || Keys(x)[j] != key[i]) {
+						// 追加
+						b = Insert(x, j, key[i], Make(key + (i + 1), length - (i + 1), value, 0, 0, 0));
+						retired.push_back(x);
+						break;
+					}
+
+					const Node* c = Children(x)[j];
+					const LTYPE r = length - (i + 1);
+					const LTYPE m = Symbols<KTYPE>::Mismatch(Label(c), key + (i + 1), std::min(c->l, r));
+
+					if (m == c->l) {
+						path.push_back(std::make_pair(x, j));
+						x = c;
+						i += c->l + 1;
+						continue;
+					}
+
+					// 分離
+					const Node* t = Make(Label(c) + (m + 1), c->l - (m + 1), c->v, Keys(c), Children(c), c->n);
+					const Node* p;
+					if (m == r) {
+						p = Make(key + (i + 1), m, value, Label(c) + m, &t, 1);
+					}
+					else {
+						const Node* u = Make(key + (i + 1 + m + 1), r - (m + 1), value, 0, 0, 0);
+						const bool o = (UTYPE)Label(c)[m] < (UTYPE)key[i + 1 + m];
+						const KTYPE k[2] = {o ? Label(c)[m] : key[i + 1 + m], o ? key[i + 1 + m] : Label(c)[m]};
+						const Node* d[2] = {o ? t : u, o ? u : t};
+						p = Make(key + (i + 1), m, INVALID, k, d, 2);
+					}
+					b = Replace(x, j, p);
+					retired.push_back(c);
+					retired.push_back(x);
+					break;
+				}
+
+				while (!path.empty()) {
+					b = Replace(path.back().first, path.back().second, b);
+					retired.push_back(path.back().first);
+					path.pop_back();
+				}
+
+				root_.store(b, std::memory_order_seq_cst);
+				for (auto r : retired) retire(r);
+				collect();
+			}
+
+		/**
+		 * キーを削除
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	キー @a key に対応する値
+		 * @note	キーが見つからなかった場合は @a INVALID が返却される。
+		 * @note	不要になったノードは除去し、子ノードが1つの非末端ノードは子ノードと統合する。
+		 */
+		VTYPE
+		remove_key(const KTYPE* key,
+				   LTYPE length)
+			{
+				assert(key);
+				assert(0 < length);
+
+				std::lock_guard<std::mutex> lock(mutex_);
+
+				std::vector<std::pair<const Node*, uint32_t> > path;	// 経路上のノードと辿った子ノードの位置
+				std::vector<const Node*> retired;	// 差し替えるノード
+				const Node* x = root_.load(std::memory_order_relaxed);
+				LTYPE i(0);
+
+				while (i < length) {
+					const uint32_t j = Lower(x, key[i]);
+					if (j == x->n || Keys(x)[j] != key[i]) return INVALID;
+
+					const Node* c = Children(x)[j];
+					if (length - (i + 1) < c->l) return INVALID;
+					if (Symbols<KTYPE>::Mismatch(Label(c), key + (i + 1), c->l) != c->l) return INVALID;
+
+					path.push_back(std::make_pair(x, j));
+					x = c;
+					i += c->l + 1;
+				}
+
+				const VTYPE r = x->v;
+				if (r == INVALID) return INVALID;
+
+				const Node* b(0);	// 経路の末端の新たなノード (0の時は除去)
+				if (x->n == 1) {
+					b = Merge(x, Keys(x)[0], Children(x)[0]);
+					retired.push_back(Children(x)[0]);
+				}
+				else if (1 < x->n) {
+					b = Make(Label(x), x->l, INVALID, Keys(x), Children(x), x->n);
+				}
+				retired.push_back(x);
+
+				while (!path.empty()) {
+					const Node* a = path.back().first;
+					const uint32_t j = path.back().second;
+					path.pop_back();
+
+					const Node* t = Replace(a, j, b);
+					if (!b && !path.empty() && a->v == INVALID && t->n == 1) {
+						b = Merge(t, Keys(t)[0], Children(t)[0]);
+						retired.push_back(Children(t)[0]);
+						::operator delete((void*)t);	// 未公開なので直ちに解放
+					}
+					else {
+						b = t;
+					}
+					retired.push_back(a);
+				}
+
+				root_.store(b, std::memory_order_seq_cst);
+				for (auto t : retired) retire(t);
+				collect();
+
+				return r;
+			}
+
+		/**
+		 * キーを探索 (キーに対応する値を獲得)
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	キー @a key に対応する値
+		 * @note	キーが見つからなかった場合は @a INVALID が返却される。
+		 * @note	ロックを取らず、追加・削除と並行に行える。
+		 */
+		VTYPE
+		get_value(const KTYPE* key,
+				  LTYPE length) const
+			{
+				assert(key);
+				assert(0 < length);
+
+				Guard g(*this);
+				const Node* x = root_.load(std::memory_order_seq_cst);
+				LTYPE i(0);
+
+				while (i < length) {
+					x = Child(x, key[i]);
+					if (!x) return INVALID;
+					if (length - (i + 1) < x->l) return INVALID;
+					if (Symbols<KTYPE>::Mismatch(Label(x), key + (i + 1), x->l) != x->l) return INVALID;
+					i += x->l + 1;
+				}
+
+				return x->v;
+			}
+
+		/**
+		 * キーを探索 (共通接頭辞探索, 接頭辞となるキーの値を全て獲得)
+		 * @param[in]	buffer	探索対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[out]	values	配列 @a buffer の接頭辞となるキーの全ての値
+		 * @note	ロックを取らず、追加・削除と並行に行える。
+		 */
+		void
+		get_values(const KTYPE* buffer,
+				   LTYPE length,
+				   std::vector<VTYPE>& values) const
+			{
+				assert(buffer);
+				assert(0 < length);
+
+				Guard g(*this);
+				const Node* x = root_.load(std::memory_order_seq_cst);
+				LTYPE i(0);
+
+				while (i < length) {
+					x = Child(x, buffer[i]);
+					if (!x) return;
+					if (length - (i + 1) < x->l) return;
+					if (Symbols<KTYPE>::Mismatch(Label(x), buffer + (i + 1), x->l) != x->l) return;
+					i += x->l + 1;
+					if (x->v != INVALID) values.push_back(x->v);
+				}
+			}
+
+		/**
+		 * キーを探索 (キーの有無をチェック)
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	true: キーが見つかった, false: 見つからなかった
+		 */
+		bool
+		find_key(const KTYPE* key,
+				 LTYPE length) const
+			{
+				assert(key);
+				assert(0 < length);
+
+				return get_value(key, length) != INVALID;
+			}
+
+		/**
+		 * 値 @a INVALID を取得
+		 * @return	値 @a INVALID
+		 */
+		static VTYPE
+		InvalidValue()
+			{
+				return INVALID;
+			}
+	};
+};
+
+#endif	// __CONCURRENT_PATRICIA_TRIE_HPP__
@@ -0,0 +1,529 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	delta_patricia_trie.hpp
+ * @brief	C++ template library of patricia trie with mutable delta on top of frozen base.
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ */
+
+#ifndef	__DELTA_PATRICIA_TRIE_HPP__
+#define	__DELTA_PATRICIA_TRIE_HPP__	"delta_patricia_trie.hpp"
+
+#include <cstdio>
+#include <cstdint>
+#include <cassert>
+#include <type_traits>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <utility>
+#include "patricia_trie.hpp"
+#include "frozen_patricia_trie.hpp"
+
+namespace ys
+{
+	/**
+	 * 凍結した木 (基底) に差分を重ねたパトリシア木
+	 * @note	基底は @a FrozenPatriciaTrie (メモリ・マップしたファイルを含む) で、変更しない。
+	 *			追加したキーは差分の @a PatriciaTrie に、基底から削除したキーは墓標の @a PatriciaTrie に記録する。
+	 * @note	探索は差分・墓標・基底の順に参照し、先に見つかったものを採用する。
+	 * @note	圧縮は次の手順で行う。
+	 *			(1) @a seal で差分を凍結 (以後の追加・削除は新たな差分に記録)。
+	 *			(2) @a compact で基底と凍結した差分を併合した木をファイルに保存。
+	 *			(3) @a open_mapped で保存したファイルを新たな基底とし、凍結した差分を破棄。
+	 * @note	@a compact は基底と凍結した差分のみを読むので、別のスレッドで実行する間も追加・削除・探索を続けられる。
+	 *			ただし @a seal, @a open_mapped とは重ねないこと。
+	 *			その他のメンバ関数の排他は @a PatriciaTrie と同じく呼び出し側が行う。
+	 * @note	テンプレートのパラメータは @a PatriciaTrie と同じ (@a ALLOCATOR は差分・墓標の木に用いる)。
+	 */
+	template<typename KTYPE, typename LTYPE, typename VTYPE, VTYPE INVALID = ~(VTYPE)0, typename ALLOCATOR = ArenaAllocator>
+	class DeltaPatriciaTrie
+	{
+	public:
+
+		typedef PatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID, ALLOCATOR> Trie;	///< 差分の型
+		typedef FrozenPatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID> Base;	///< 基底の型
+
+	private:
+
+		/**
+		 * 差分
+		 * @note	同じキーが @a a と @a r の両方にあることはない。
+		 */
+		struct Layer
+		{
+			Trie a;	///< 追加したキー
+			Trie r;	///< 下の層から削除したキー (墓標, 値は @a Tomb)
+
+			/**
+			 * コンストラクタ
+			 */
+			Layer()
+				: a(), r()
+				{
+					;
+				}
+		};
+
+		/**
+		 * 共通接頭辞探索の結果
+		 * @note	@a SPAN 件までは固定長の配列に、それを超える時は可変長の配列に格納する。
+		 */
+		class Matches
+		{
+		public:
+
+			enum {
+				SPAN = 16	///< 固定長の配列の要素数
+			};
+
+			VTYPE v[SPAN];	///< 値
+			LTYPE l[SPAN];	///< キーの長さ
+			std::vector<std::pair<LTYPE, VTYPE> > x;	///< 値とキーの長さ (@a SPAN 件を超える時)
+			size_t n;	///< 結果の数
+			size_t i;	///< 次に参照する結果
+
+			/**
+			 * コンストラクタ
+			 */
+			Matches()
+				: v(), l(), x(), n(0), i(0)
+				{
+					;
+				}
+
+			/**
+			 * 共通接頭辞探索
+			 * @param[in]	t	探索する木 (0を許す)
+			 * @param[in]	buffer	探索対象のデータ
+			 * @param[in]	length	配列 @a buffer の要素数
+			 */
+			template<typename CODE>
+			void
+			collect(const Trie* t,
+					const KTYPE* buffer,
+					LTYPE length)
+				{
+					if (!t) return;
+
+					n = t->template get_values<CODE>(buffer, length, v, SPAN, l);
+					if (n < SPAN) return;
+
+					t->template get_values<CODE>(buffer, length, [this](VTYPE w, LTYPE m) {
+							x.push_back(std::make_pair(m, w));
+							return true;
+						});
+					n = x.size();
+				}
+
+			/**
+			 * 未参照の結果の有無
+			 * @return	true: ある, false: ない
+			 */
+			bool
+			more() const
+				{
+					return i < n;
+				}
+
+			/**
+			 * 次に参照する結果のキーの長さ
+			 * @return	キーの長さ
+			 */
+			LTYPE
+			length() const
+				{
+					assert(more());
+
+					return x.empty() ? l[i] : x[i].first;
+				}
+
+			/**
+			 * 次に参照する結果の値
+			 * @return	値
+			 */
+			VTYPE
+			value() const
+				{
+					assert(more());
+
+					return x.empty() ? v[i] : x[i].second;
+				}
+		};
+
+		Base* base_;	///< 基底
+		Layer* delta_;	///< 差分
+		Layer* sealed_;	///< 凍結した差分 (0を許す)
+
+		/**
+		 * 墓標の値を取得
+		 * @return	墓標の値 (@a INVALID 以外)
+		 */
+		static VTYPE
+		Tomb()
+			{
+				return (VTYPE)~INVALID;
+			}
+
+		/**
+		 * 要素を符号なし整数とみなした辞書順でキーを比較
+		 * @param[in]	a	キー
+		 * @param[in]	m	配列 @a a の要素数
+		 * @param[in]	b	キー
+		 * @param[in]	n	配列 @a b の要素数
+		 * @return	true: @a a が @a b より前, false: それ以外
+		 */
+		static bool
+		Less(const KTYPE* a,
+			 size_t m,
+			 const KTYPE* b,
+			 size_t n)
+			{
+				typedef typename std::make_unsigned<KTYPE>::type UTYPE;
+
+				const size_t k = std::min(m, n);
+				const size_t i = Symbols<KTYPE>::Mismatch(a, b, k);
+				if (i < k) return (UTYPE)a[i] < (UTYPE)b[i];
+				return m < n;
+			}
+
+		/**
+		 * 差分より下の層でキーを探索
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	キー @a key に対応する値
+		 */
+		VTYPE
+		lower(const KTYPE* key,
+			  LTYPE length) const
+			{
+				if (sealed_) {
+					const VTYPE v = sealed_->a.get_value(key, length);
+					if (v != INVALID) return v;
+					if (sealed_->r.find_key(key, length)) return INVALID;
+				}
+
+				return base_->get_value(key, length);
+			}
+
+	public:
+
+		/**
+		 * コンストラクタ
+		 * @note	基底は空の木となる。
+		 */
+		DeltaPatriciaTrie()
+			: base_(new Base()), delta_(new Layer()), sealed_(0)
+			{
+				;
+			}
+
+		/**
+		 * コピー・コンストラクタ (使用禁止)
+		 */
+		DeltaPatriciaTrie(const DeltaPatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID, ALLOCATOR>&) = delete;
+
+		/**
+		 * 代入演算子 (使用禁止)
+		 */
+		DeltaPatriciaTrie&
+		operator =(const DeltaPatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID, ALLOCATOR>&) = delete;
+
+		/**
+		 * デストラクタ
+		 */
+		virtual
+		~DeltaPatriciaTrie()
+			{
+				delete sealed_;
+				delete delta_;
+				delete base_;
+			}
+
+		/**
+		 * ファイルをメモリ・マップして基底とする
+		 * @param[in]	path	@a FrozenPatriciaTrie::save または @a compact で保存したファイルのパス
+		 * @return	true: 成功, false: 失敗 (内容は変化しない)
+		 * @note	成功した時は凍結した差分を破棄する (@a compact の結果に含まれるため)。
+		 *			差分は保持する。
+		 */
+		bool
+		open_mapped(const char* path)
+			{
+				assert(path);
+
+				Base* b = new Base();
+				if (!b->open_mapped(path)) {
+					delete b;
+					return false;
+				}
+
+				std::swap(base_, b);
+				delete b;
+				delete sealed_;
+				sealed_ = 0;
+
+				return true;
+			}
+
+		/**
+		 * 差分を凍結
+		 * @return	true: 成功, false: 凍結した差分が既にある
+		 * @note	以後の追加・削除は新たな差分に記録する。
+		 */
+		bool
+		seal()
+			{
+				if (sealed_) return false;
+
+				Layer* l = new Layer();
+				sealed_ = delta_;
+				delta_ = l;
+
+				return true;
+			}
+
+		/**
+		 * 基底と凍結した差分を併合した木をファイルに保存
+		 * @param[in]	path	保存先のファイルのパス
+		 * @return	true: 成功, false: 失敗
+		 * @note	凍結した差分がない時は基底のみを保存する。
+		 * @note	@a path に ".tmp" を付けたファイルに保存してから名前を変えるので、
+		 *			基底としてマップ中のファイルを置き換えてもよい。
+		 * @note	基底の全てのキーを昇順に辿りながら凍結した差分と併合し、
+		 *			@a PatriciaTrie::build_from_sorted で構築してから凍結して保存する。
+		 */
+		bool
+		compact(const char* path) const
+			{
+				assert(path);
+
+				typedef std::pair<std::vector<KTYPE>, VTYPE> Entry;
+
+				std::vector<Entry> e;
+				typename Trie::Iterator it, end;
+				if (sealed_) {
+					it = sealed_->a.begin();
+					end = sealed_->a.end();
+				}
+
+				base_->for_each([&](const KTYPE* key, LTYPE length, VTYPE value) {
+						for (; it != end && Less(it.key(), it.length(), key, length); ++it) {
+							e.push_back(Entry(std::vector<KTYPE>(it.key(), it.key() + it.length()), it.value()));
+						}
+
+						if (it != end && !Less(key, length, it.key(), it.length())) return true;	// 差分で置き換えたキー
+						if (sealed_ && sealed_->r.find_key(key, length)) return true;	// 削除したキー
+
+						e.push_back(Entry(std::vector<KTYPE>(key, key + length), value));
+						return true;
+					});
+
+				for (; it != end; ++it) {
+					e.push_back(Entry(std::vector<KTYPE>(it.key(), it.key() + it.length()), it.value()));
+				}
+
+				Trie t;
+				t.build_from_sorted(e.begin(), e.end());
+				std::vector<Entry>().swap(e);
+
+				// 基底のファイルと同じパスでも、マップ中の領域を壊さないように別のファイルから置き換える
+				const std::string tmp = std::string(path) + ".tmp";
+				Base b(t);
+				if (!b.save(tmp.c_str()) || std::rename(tmp.c_str(), path) != 0) {
+					std::remove(tmp.c_str());
+					return false;
+				}
+
+				return true;
+			}
+
+		/**
+		 * キーを追加
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @param[in]	value	キー @a key に対応する値
+		 * @note	引数 @a value に @a INVALID を代入しないこと。
+		 * @note	差分に記録する。
+		 */
+		void
+		add_key(const KTYPE* key,
+				LTYPE length,
+				VTYPE value = 0)
+			{
+				delta_->a.add_key(key, length, value);
+				delta_->r.remove_key(key, length);
+			}
+
+		/**
+		 * キーを削除
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	キー @a key に対応する値
+		 * @note	キーが見つからなかった場合は @a INVALID が返却される。
+		 * @note	下の層 (凍結した差分・基底) にキーがある時は墓標を記録する。
+		 */
+		VTYPE
+		remove_key(const KTYPE* key,
+				   LTYPE length)
+			{
+				if (delta_->r.find_key(key, length)) return INVALID;
+
+				VTYPE v = delta_->a.remove_key(key, length);
+				const VTYPE w = lower(key, length);
+				if (w != INVALID) {
+					delta_->r.add_key(key, length, Tomb());
+					if (v == INVALID) v = w;
+				}
+
+				return v;
+			}
+
+		/**
+		 * キーを探索 (キーに対応する値を獲得)
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	キー @a key に対応する値
+		 * @note	キーが見つからなかった場合は @a INVALID が返却される。
+		 */
+		VTYPE
+		get_value(const KTYPE* key,
+				  LTYPE length) const
+			{
+				const VTYPE v = delta_->a.get_value(key, length);
+				if (v != INVALID) return v;
+				if (delta_->r.find_key(key, length)) return INVALID;
+
+				return lower(key, length);
+			}
+
+		/**
+		 * キーを探索 (共通接頭辞探索, 接頭辞となるキーの値を全て獲得)
+		 * @param[in]	buffer	探索対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[out]	values	配列 @a buffer の接頭辞となるキーの全ての値 (短い順)
+		 * @note	テンプレートのパラメータ @a CODE は @a PatriciaTrie::get_values と同じ。
+		 */
+		template<typename CODE = Elements<KTYPE> >
+		void
+		get_values(const KTYPE* buffer,
+				   LTYPE length,
+				   std::vector<VTYPE>& values) const
+			{
+				get_values<CODE>(buffer, length, [&values](VTYPE v, LTYPE) { values.push_back(v); return true; });
+			}
+
+		/**
+		 * キーを探索 (共通接頭辞探索, 接頭辞となるキーを順に訪問)
+		 * @param[in]	buffer	探索対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[in]	visitor	接頭辞となるキーが見つかる度に短い順に呼び出す関数 (引数は値・キーの長さ, false を返すと探索を中止)
+		 * @note	差分・凍結した差分の結果を先に集め、基底の探索に合わせて長さの順に併合する。
+		 *			差分の結果が @a Matches::SPAN 件以下の時は領域を確保しない。
+		 * @note	テンプレートのパラメータ @a CODE は @a PatriciaTrie::get_values と同じ。
+		 */
+		template<typename CODE = Elements<KTYPE>, typename VISITOR>
+		void
+		get_values(const KTYPE* buffer,
+				   LTYPE length,
+				   VISITOR visitor) const
+			{
+				assert(buffer);
+				assert(0 < length);
+
+				// 上の層から順に: 差分の追加・差分の墓標・凍結した差分の追加・凍結した差分の墓標
+				Matches m[4];
+				m[0].template collect<CODE>(&delta_->a, buffer, length);
+				m[1].template collect<CODE>(&delta_->r, buffer, length);
+				m[2].template collect<CODE>(sealed_ ? &sealed_->a : 0, buffer, length);
+				m[3].template collect<CODE>(sealed_ ? &sealed_->r : 0, buffer, length);
+
+				// 長さ @a l のキーを最も上の層で解決 (層の番号を返し、見つからなかった時は -1)
+				auto resolve = [&m](LTYPE l, VTYPE& v) {
+					int r(-1);
+					for (int j(0); j < 4; ++j) {
+						if (!m[j].more() || m[j].length() != l) continue;
+						if (r < 0) {
+							r = j;
+							v = m[j].value();
+						}
+						++m[j].i;
+					}
+					return r;
+				};
+
+				// 長さ @a l 未満 (@a all の時は全て) の差分の結果を報告
+				auto flush = [&](bool all, LTYPE l) {
+					for (;;) {
+						int k(-1);
+						for (int j(0); j < 4; ++j) {
+							if (!m[j].more() || (!all && l <= m[j].length())) continue;
+							if (k < 0 || m[j].length() < m[k].length()) k = j;
+						}
+						if (k < 0) return true;
+
+						const LTYPE n = m[k].length();
+						VTYPE v(INVALID);
+						if (resolve(n, v) % 2 == 0 && !visitor(v, n)) return false;
+					}
+				};
+
+				bool go(true);
+				base_->template get_values<CODE>(buffer, length, [&](VTYPE v, LTYPE l) {
+						if (!flush(false, l)) return go = false;
+
+						VTYPE w(v);
+						const int r = resolve(l, w);
+						if (r == 1 || r == 3) return true;	// 削除したキー
+						if (!visitor(w, l)) return go = false;
+						return true;
+					});
+
+				if (go) flush(true, 0);
+			}
+
+		/**
+		 * キーを探索 (キーの有無をチェック)
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	true: キーが見つかった, false: 見つからなかった
+		 */
+		bool
+		find_key(const KTYPE* key,
+				 LTYPE length) const
+			{
+				return get_value(key, length) != INVALID;
+			}
+
+		/**
+		 * 基底を取得
+		 * @return	基底
+		 */
+		const Base&
+		base() const
+			{
+				return *base_;
+			}
+
+		/**
+		 * 凍結した差分の有無
+		 * @return	true: ある (@a compact, @a open_mapped の前), false: ない
+		 */
+		bool
+		sealed() const
+			{
+				return sealed_ != 0;
+			}
+
+		/**
+		 * 値 @a INVALID を取得
+		 * @return	値 @a INVALID
+		 */
+		static VTYPE
+		InvalidValue()
+			{
+				return INVALID;
+			}
+	};
+};
+
+#endif	// __DELTA_PATRICIA_TRIE_HPP__
@@ -0,0 +1,978 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	frozen_patricia_trie.hpp
+ * @brief	C++ template library of frozen (read-only) patricia trie.
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ */
+
+#ifndef	__FROZEN_PATRICIA_TRIE_HPP__
+#define	__FROZEN_PATRICIA_TRIE_HPP__	"frozen_patricia_trie.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+#include <type_traits>
+#include <algorithm>
+#include <vector>
+#include <utility>
+#if	defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define	__FROZEN_PATRICIA_TRIE_MMAP__
+#endif
+#include "patricia_trie.hpp"
+
+namespace ys
+{
+	template<typename KTYPE, typename LTYPE, typename VTYPE, VTYPE INVALID>
+	class SuccinctPatriciaTrie;
+
+	/**
+	 * 凍結したパトリシア木 (読み出し専用)
+	 * @note	全ノードを幅優先順に1つの連続した領域へ配置する。
+	 *			あるノードの子ノードは連続しており、キーの昇順に並ぶ。
+	 * @note	ノードの位置・キーの位置は32ビットの添字で表すため、
+	 *			ノード数・キーの要素数の合計はそれぞれ 2^32 未満であること。
+	 * @note	領域はそのままファイルに保存でき、保存したファイルはメモリ・マップして解析せずに探索できる。
+	 *			ファイルは保存した環境と同じバイト順・同じテンプレートのパラメータでのみ読み込める。
+	 * @note	テンプレートのパラメータは @a PatriciaTrie と同じ。
+	 */
+	template<typename KTYPE, typename LTYPE, typename VTYPE, VTYPE INVALID = ~(VTYPE)0>
+	class FrozenPatriciaTrie
+	{
+		template<typename K_, typename L_, typename V_, V_ I_>
+		friend class SuccinctPatriciaTrie;
+
+	private:
+
+		typedef typename std::make_unsigned<KTYPE>::type UTYPE;	///< キーの比較に用いる型
+
+		enum {
+			VERSION = 2,			///< ファイル形式の版数
+			ORDER = 0x01020304		///< バイト順の確認用の値
+		};
+
+		/**
+		 * 領域の先頭に置く管理情報
+		 */
+		struct Image
+		{
+			char magic[8];	///< 識別子 ("YSPTRIE" + '\0')
+			uint32_t version;	///< ファイル形式の版数
+			uint32_t order;	///< バイト順の確認用の値
+			uint32_t key_size;	///< キーの値のバイト数
+			uint32_t value_size;	///< 値のバイト数
+			uint32_t record_size;	///< ノードのバイト数
+			uint32_t n;	///< ノードの数
+			uint32_t m;	///< キーの全体を連結したものの要素数
+			uint32_t reserved;	///< 予約 (0)
+			uint64_t invalid;	///< 値 @a INVALID
+			uint64_t size;	///< 管理情報を含む領域全体のバイト数
+		};
+
+		/**
+		 * ノード
+		 * @note	根 (添字0) は空のキーを持つ非末端ノードで、その子ノードが各キーの先頭の値に対応する。
+		 */
+		struct Record
+		{
+			uint32_t c;	///< 先頭の子ノードの添字
+			uint32_t n;	///< 子ノードの数
+			uint32_t d;	///< キーの全体の位置 (配列 @a d_ の添字)
+			uint32_t l;	///< キーの全体の長さ
+			VTYPE v;	///< キー末端 (非末端の時は @a INVALID)
+			VTYPE u;	///< 自身と子孫のキー末端の最大値 (キー末端がない時は @a INVALID)
+		};
+
+		std::vector<uint64_t> b_;	///< 全ノード・全キーを格納する領域
+		void* p_;	///< メモリ・マップした領域 (0を許す)
+		size_t z_;	///< メモリ・マップした領域のバイト数
+		const Record* r_;	///< ノード群 (幅優先順)
+		const KTYPE* s_;	///< 各ノードに至るキーの値 (配列 @a r_ と同じ添字)
+		const KTYPE* d_;	///< 各ノードのキーの全体を連結したもの
+		uint32_t n_;	///< ノードの数
+		uint32_t m_;	///< 配列 @a d_ の要素数
+
+		/**
+		 * 子ノードを探索
+		 * @param[in]	r	親ノード
+		 * @param[in]	k	子ノードに至るキーの値
+		 * @return	子ノードの添字 (見つからなかった時は0)
+		 */
+		uint32_t
+		child(const Record& r,
+			  KTYPE k) const
+			{
+				const KTYPE* s = s_ + r.c;
+				uint32_t i(0);
+				uint32_t j = r.n;
+
+				// 線形探索 (キーの値の配列の後ろにはキーの全体の配列が続くので、その範囲内で先読みを許す)
+				if (j <= Symbols<KTYPE>::Span() && (size_t)r.c + ((j + 15) & ~15u) <= (size_t)n_ + m_) {
+					i = Symbols<KTYPE>::Find(s, j, k);
+					return i < j ? r.c + i : 0;
+				}
+
+				while (i < j) {
+					uint32_t c = (i + j) / 2;
+					if ((UTYPE)s[c] < (UTYPE)k) i = c + 1;
+					else j = c;
+				}
+
+				return (i < r.n && s[i] == k) ? r.c + i : 0;
+			}
+
+		/**
+		 * 親ノードを探索
+		 * @param[in]	x	ノードの添字 (根以外)
+		 * @return	親ノードの添字
+		 * @note	子ノードは幅優先順に連続するので、先頭の子ノードの添字が @a x 以下である最後のノードが親となる。
+		 */
+		uint32_t
+		parent(uint32_t x) const
+			{
+				assert(0 < x && x < n_);
+
+				uint32_t i(0);
+				uint32_t j(x);
+
+				while (i + 1 < j) {
+					uint32_t c = (i + j) / 2;
+					if (r_[c].c <= x) i = c;
+					else j = c;
+				}
+
+				return i;
+			}
+
+		/**
+		 * 管理情報の先頭からノード群までのバイト数を取得
+		 * @return	バイト数
+		 */
+		static size_t
+		Head()
+			{
+				return Round(sizeof(Image));
+			}
+
+		/**
+		 * バイト数を8の倍数に切り上げ
+		 * @param[in]	size	バイト数
+		 * @return	切り上げたバイト数
+		 */
+		static size_t
+		Round(size_t size)
+			{
+				return (size + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+			}
+
+		/**
+		 * 領域全体のバイト数を計算
+		 * @param[in]	n	ノードの数
+		 * @param[in]	m	キーの全体を連結したものの要素数
+		 * @return	バイト数
+		 */
+		static size_t
+		Size(uint32_t n,
+			 uint32_t m)
+			{
+				return Head() + Round(sizeof(Record) * n) + sizeof(KTYPE) * ((size_t)n + m);
+			}
+
+		/**
+		 * 領域の管理情報を検査
+		 * @param[in]	image	領域の先頭
+		 * @param[in]	size	領域のバイト数
+		 * @return	true: 正しい, false: 正しくない
+		 */
+		static bool
+		Check(const void* image,
+			  size_t size)
+			{
+				if (size < Head()) return false;
+
+				const Image* h = (const Image*)image;
+				if (std::memcmp((const void*)h->magic, (const void*)"YSPTRIE", 8) != 0) return false;
+				if (h->version != VERSION || h->order != ORDER) return false;
+				if (h->key_size != sizeof(KTYPE) || h->value_size != sizeof(VTYPE) || h->record_size != sizeof(Record)) return false;
+				if (h->invalid != (uint64_t)INVALID) return false;
+				if (h->n == 0 || h->size != Size(h->n, h->m) || size < h->size) return false;
+
+				return true;
+			}
+
+		/**
+		 * 領域のノード群・キー群を参照
+		 * @param[in]	image	領域の先頭 (検査済みであること)
+		 */
+		void
+		attach(const void* image)
+			{
+				const Image* h = (const Image*)image;
+
+				n_ = h->n;
+				m_ = h->m;
+				r_ = (const Record*)((const char*)image + Head());
+				s_ = (const KTYPE*)((const char*)r_ + Round(sizeof(Record) * n_));
+				d_ = s_ + n_;
+			}
+
+		/**
+		 * メモリ・マップした領域を解放
+		 */
+		void
+		unmap()
+			{
+#ifdef	__FROZEN_PATRICIA_TRIE_MMAP__
+				if (p_) ::munmap(p_, z_);
+#endif
+				p_ = 0;
+				z_ = 0;
+			}
+
+		/**
+		 * 領域を確保してノード群・キー群を配置
+		 * @param[in]	records	ノード群
+		 * @param[in]	symbols	各ノードに至るキーの値
+		 * @param[in]	labels	各ノードのキーの全体を連結したもの
+		 */
+		void
+		pack(const std::vector<Record>& records,
+			 const std::vector<KTYPE>& symbols,
+			 const std::vector<KTYPE>& labels)
+			{
+				assert(records.size() == symbols.size());
+				assert(records.size() <= (size_t)UINT32_MAX);
+				assert(labels.size() <= (size_t)UINT32_MAX);
+
+				const uint32_t n = (uint32_t)records.size();
+				const uint32_t m = (uint32_t)labels.size();
+				const size_t t = Size(n, m);
+				b_.assign(Round(t) / sizeof(uint64_t), 0);
+
+				char* p = (char*)b_.data();
+				Image* h = (Image*)p;
+				std::memcpy((void*)h->magic, (const void*)"YSPTRIE", 8);
+				h->version = VERSION;
+				h->order = ORDER;
+				h->key_size = (uint32_t)sizeof(KTYPE);
+				h->value_size = (uint32_t)sizeof(VTYPE);
+				h->record_size = (uint32_t)sizeof(Record);
+				h->n = n;
+				h->m = m;
+				h->reserved = 0;
+				h->invalid = (uint64_t)INVALID;
+				h->size = t;
+
+				p += Head();
+				std::memcpy((void*)p, (const void*)records.data(), sizeof(Record) * n);
+				Record* r = (Record*)p;
+				for (uint32_t x = n; 0 < x; --x) {
+					// 子ノードは親ノードより後ろにあるので、末尾から子孫の最大値を集約
+					Record& t = r[x - 1];
+					t.u = t.v;
+					for (uint32_t y = t.c; y < t.c + t.n; ++y) {
+						if (r[y].u != INVALID && (t.u == INVALID || t.u < r[y].u)) t.u = r[y].u;
+					}
+				}
+				p += Round(sizeof(Record) * n);
+				std::memcpy((void*)p, (const void*)symbols.data(), sizeof(KTYPE) * n);
+				p += sizeof(KTYPE) * n;
+				if (0 < m) std::memcpy((void*)p, (const void*)labels.data(), sizeof(KTYPE) * m);
+
+				attach(b_.data());
+			}
+
+		/**
+		 * 空の木を配置
+		 */
+		void
+		clear()
+			{
+				std::vector<Record> records(1);
+				records[0].c = 1;
+				records[0].n = records[0].d = records[0].l = 0;
+				records[0].v = INVALID;
+
+				pack(records, std::vector<KTYPE>(1, (KTYPE)0), std::vector<KTYPE>());
+			}
+
+	public:
+
+		/**
+		 * コンストラクタ
+		 * @note	空の木を生成する。
+		 */
+		FrozenPatriciaTrie()
+			: b_(), p_(0), z_(0), r_(0), s_(0), d_(0), n_(0), m_(0)
+			{
+				clear();
+			}
+
+		/**
+		 * コンストラクタ
+		 * @param[in]	trie	凍結するパトリシア木
+		 * @note	凍結後に @a trie を変更しても、このオブジェクトには反映されない。
+		 */
+		template<typename ALLOCATOR, typename COUNTER>
+		explicit
+		FrozenPatriciaTrie(const PatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID, ALLOCATOR, COUNTER>& trie)
+			: b_(), p_(0), z_(0), r_(0), s_(0), d_(0), n_(0), m_(0)
+			{
+				typedef typename PatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID, ALLOCATOR, COUNTER>::template Node<KTYPE, LTYPE, VTYPE> N;
+
+				std::vector<const N*> q(1, (const N*)0);	// 幅優先探索の待ち行列 (根は0)
+				std::vector<Record> records(1);
+				std::vector<KTYPE> symbols(1, (KTYPE)0);
+				std::vector<KTYPE> labels;
+
+				records[0].l = records[0].d = 0;
+				records[0].v = INVALID;
+
+				for (size_t x(0); x < q.size(); ++x) {
+					const auto& c = q[x] ? q[x]->c_ : trie.head_;
+					records[x].c = (uint32_t)q.size();
+					records[x].n = (uint32_t)c.size();
+
+					for (uint32_t i(0), e = c.end(); i < e; ++i) {
+						const N* node = c.node_at(i);
+						if (!node) continue;
+
+						Record r;
+						r.c = r.n = 0;
+						r.d = (uint32_t)labels.size();
+						r.l = (uint32_t)node->l_;
+						r.v = node->v_;
+
+						q.push_back(node);
+						records.push_back(r);
+						symbols.push_back(c.key_at(i));
+						labels.insert(labels.end(), node->d_, node->d_ + node->l_);
+					}
+				}
+
+				pack(records, symbols, labels);
+			}
+
+		/**
+		 * コピー・コンストラクタ (使用禁止)
+		 */
+		FrozenPatriciaTrie(const FrozenPatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID>&) = delete;
+
+		/**
+		 * 代入演算子 (使用禁止)
+		 */
+		FrozenPatriciaTrie&
+		operator =(const FrozenPatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID>&) = delete;
+
+		/**
+		 * デストラクタ
+		 */
+		virtual
+		~FrozenPatriciaTrie()
+			{
+				unmap();
+			}
+
+		/**
+		 * ファイルに保存
+		 * @param[in]	path	保存先のファイルのパス
+		 * @return	true: 成功, false: 失敗
+		 */
+		bool
+		save(const char* path) const
+			{
+				assert(path);
+
+				FILE* file = std::fopen(path, "wb");
+				if (!file) return false;
+
+				const size_t size = ((const Image*)((const char*)r_ - Head()))->size;
+				bool r = std::fwrite((const void*)((const char*)r_ - Head()), 1, size, file) == size;
+				if (std::fclose(file) != 0) r = false;
+
+				return r;
+			}
+
+		/**
+		 * ファイルをメモリ・マップして読み込み
+		 * @param[in]	path	@a save で保存したファイルのパス
+		 * @return	true: 成功, false: 失敗 (内容は変化しない)
+		 * @note	ファイルは読み出し専用でマップするため、複数のプロセスでページ・キャッシュを共有できる。
+		 * @note	メモリ・マップできない環境では、ファイルの内容を全て読み込む。
+		 * @note	管理情報のみを検査するため、信頼できるファイルを与えること。
+		 */
+		bool
+		open_mapped(const char* path)
+			{
+				assert(path);
+
+#ifdef	__FROZEN_PATRICIA_TRIE_MMAP__
+				int fd = ::open(path, O_RDONLY);
+				if (fd < 0) return false;
+
+				struct stat st;
+				if (::fstat(fd, &st) != 0 || (size_t)st.st_size < Head()) {
+					::close(fd);
+					return false;
+				}
+
+				const size_t size = (size_t)st.st_size;
+				void* p = ::mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+				::close(fd);
+				if (p == MAP_FAILED) return false;
+
+				if (!Check(p, size)) {
+					::munmap(p, size);
+					return false;
+				}
+
+				unmap();
+				std::vector<uint64_t>().swap(b_);
+				p_ = p;
+				z_ = size;
+				attach(p);
+#else
+				FILE* file = std::fopen(path, "rb");
+				if (!file) return false;
+
+				// 末尾の端数の語も読めるよう、バイト単位で読み込む
+				long size(-1);
+				if (std::fseek(file, 0, SEEK_END) == 0) size = std::ftell(file);
+				if (size < (long)Head() || std::fseek(file, 0, SEEK_SET) != 0) {
+					std::fclose(file);
+					return false;
+				}
+
+				std::vector<uint64_t> b(((size_t)size + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+				const size_t k = std::fread((void*)b.data(), 1, (size_t)size, file);
+				std::fclose(file);
+
+				if (k != (size_t)size || !Check((const void*)b.data(), (size_t)size)) return false;
+
+				b_.swap(b);
+				attach(b_.data());
+#endif
+
+				return true;
+			}
+
+		/**
+		 * キーを探索 (キーに対応する値を獲得)
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	キー @a key に対応する値
+		 * @note	キーが見つからなかった場合は @a INVALID が返却される。
+		 */
+		VTYPE
+		get_value(const KTYPE* key,
+				  LTYPE length) const
+			{
+				assert(key);
+				assert(0 < length);
+
+				uint32_t x = child(r_[0], key[0]);
+				if (!x) return INVALID;
+				LTYPE i(1);
+
+				for (;;) {
+					const Record& r = r_[x];
+					if (length - i < r.l) return INVALID;
+					if (Symbols<KTYPE>::Mismatch(d_ + r.d, key + i, (LTYPE)r.l) != r.l) return INVALID;
+					i += r.l;
+					if (i == length) return r.v;
+
+					x = child(r, key[i]);
+					if (!x) return INVALID;
+					++i;
+				}
+			}
+
+		/**
+		 * キーを探索 (共通接頭辞探索, 接頭辞となるキーの値を全て獲得)
+		 * @param[in]	buffer	探索対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[out]	values	配列 @a buffer の接頭辞となるキーの全ての値
+		 * @note	テンプレートのパラメータ @a CODE には区切りの方針 (@a Elements, @a Utf8 等) を与え、区切りで終わるキーのみを対象とする。
+		 */
+		template<typename CODE = Elements<KTYPE> >
+		void
+		get_values(const KTYPE* buffer,
+				   LTYPE length,
+				   std::vector<VTYPE>& values) const
+			{
+				get_values<CODE>(buffer, length, [&values](VTYPE v, LTYPE) { values.push_back(v); return true; });
+			}
+
+		/**
+		 * キーを探索 (共通接頭辞探索, 接頭辞となるキーの値を固定長の配列に獲得)
+		 * @param[in]	buffer	探索対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[out]	values	配列 @a buffer の接頭辞となるキーの値 (短い順)
+		 * @param[in]	capacity	配列 @a values の要素数
+		 * @param[out]	lengths	各キーの長さ (0を許す, 要素数 @a capacity)
+		 * @return	格納した値の数
+		 * @note	配列 @a values が埋まった時点で探索を終了する。
+		 * @note	テンプレートのパラメータ @a CODE には区切りの方針 (@a Elements, @a Utf8 等) を与え、区切りで終わるキーのみを対象とする。
+		 */
+		template<typename CODE = Elements<KTYPE> >
+		size_t
+		get_values(const KTYPE* buffer,
+				   LTYPE length,
+				   VTYPE* values,
+				   size_t capacity,
+				   LTYPE* lengths = 0) const
+			{
+				assert(values || capacity == 0);
+
+				size_t n(0);
+				if (capacity == 0) return n;
+
+				get_values<CODE>(buffer, length, [&](VTYPE v, LTYPE l) {
+						if (lengths) lengths[n] = l;
+						values[n] = v;
+						return ++n < capacity;
+					});
+
+				return n;
+			}
+
+		/**
+		 * キーを探索 (共通接頭辞探索, 接頭辞となるキーを順に訪問)
+		 * @param[in]	buffer	探索対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[in]	visitor	接頭辞となるキーが見つかる度に短い順に呼び出す関数 (引数は値・キーの長さ, false を返すと探索を中止)
+		 * @note	領域を確保しない。
+		 * @note	テンプレートのパラメータ @a CODE には区切りの方針 (@a Elements, @a Utf8 等) を与え、区切りで終わるキーのみを対象とする。
+		 */
+		template<typename CODE = Elements<KTYPE>, typename VISITOR>
+		void
+		get_values(const KTYPE* buffer,
+				   LTYPE length,
+				   VISITOR visitor) const
+			{
+				assert(buffer);
+				assert(0 < length);
+
+				uint32_t x = child(r_[0], buffer[0]);
+				if (!x) return;
+				LTYPE i(1);
+
+				for (;;) {
+					const Record& r = r_[x];
+					if (length - i < r.l) return;
+					if (Symbols<KTYPE>::Mismatch(d_ + r.d, buffer + i, (LTYPE)r.l) != r.l) return;
+					i += r.l;
+					if (r.v != INVALID && CODE::Boundary(buffer, (size_t)length, (size_t)i) && !visitor(r.v, i)) return;
+					if (i == length) return;
+
+					x = child(r, buffer[i]);
+					if (!x) return;
+					++i;
+				}
+			}
+
+		/**
+		 * キーを探索 (最長一致, 接頭辞となる最長のキーの値を獲得)
+		 * @param[in]	buffer	探索対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[out]	matched	一致したキーの長さ (0を許す, 見つからなかった時は変更しない)
+		 * @return	配列 @a buffer の接頭辞となる最長のキーの値
+		 * @note	キーが見つからなかった場合は @a INVALID が返却される。
+		 * @note	領域を確保せず、辿ったキー末端のうち最も深いもののみを保持する。
+		 * @note	テンプレートのパラメータ @a CODE には区切りの方針 (@a Elements, @a Utf8 等) を与え、区切りで終わるキーのみを対象とする。
+		 */
+		template<typename CODE = Elements<KTYPE> >
+		VTYPE
+		get_longest_prefix(const KTYPE* buffer,
+						   LTYPE length,
+						   LTYPE* matched = 0) const
+			{
+				VTYPE r(INVALID);
+				LTYPE n(0);
+
+				get_values<CODE>(buffer, length, [&](VTYPE v, LTYPE l) {
+						r = v;
+						n = l;
+						return true;
+					});
+
+				if (matched && r != INVALID) *matched = n;
+				return r;
+			}
+
+		/**
+		 * データを走査 (データ中に現れるキーを全て報告)
+		 * @param[in]	buffer	走査対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[in]	callback	キーが現れる度に呼び出す関数 (引数は位置・キーの長さ・値, false を返すと走査を中止)
+		 * @param[in]	mode	走査の方式
+		 * @return	報告したキーの数
+		 * @note	@a PatriciaTrie::scan と同じく、各位置から共通接頭辞探索を行う。
+		 */
+		template<typename CODE = Elements<KTYPE>, typename CALLBACK>
+		size_t
+		scan(const KTYPE* buffer,
+			 size_t length,
+			 CALLBACK callback,
+			 ScanMode mode = SCAN_ALL) const
+			{
+				assert(buffer || length == 0);
+
+				size_t r(0);
+				size_t i(0);
+
+				while (i < length) {
+					uint32_t x = child(r_[0], buffer[i]);
+					size_t j = i + 1;	// 照合済みの位置
+					size_t b(0);	// 最長のキーの長さ
+					VTYPE v(INVALID);	// 最長のキーの値
+
+					while (x) {
+						const Record& t = r_[x];
+						if (length - j < (size_t)t.l) break;
+						if (Symbols<KTYPE>::Mismatch(d_ + t.d, buffer + j, (LTYPE)t.l) != t.l) break;
+						j += t.l;
+						if (t.v != INVALID && CODE::Boundary(buffer, length, j)) {
+							if (mode == SCAN_ALL) {
+								++r;
+								if (!callback(i, (LTYPE)(j - i), t.v)) return r;
+							}
+							else {
+								b = j - i;
+								v = t.v;
+							}
+						}
+						if (j == length) break;
+						x = child(t, buffer[j]);
+						++j;
+					}
+
+					if (v != INVALID) {
+						++r;
+						if (!callback(i, (LTYPE)b, v)) return r;
+						i += b;
+					}
+					else {
+						i = CODE::Next(buffer, length, i);
+					}
+				}
+
+				return r;
+			}
+
+		/**
+		 * 接頭辞を持つキーのうち値の大きいものを取得 (上位 k 件の補完)
+		 * @param[in]	prefix	接頭辞
+		 * @param[in]	length	配列 @a prefix の要素数
+		 * @param[in]	k	取得するキーの数の上限
+		 * @param[in]	visitor	キーを値の降順に渡す関数 (引数はキー・キーの長さ・値, false を返すと探索を中止)
+		 * @return	渡したキーの数
+		 * @note	値をキーの得点とみなし、各ノードの子孫の値の最大値を用いた最良優先探索で、
+		 *			子孫の全体を辿らずにおおむね k とキーの長さの積に比例する手間で取得する。
+		 * @note	値が等しいキーの順序は不定。
+		 */
+		template<typename VISITOR>
+		size_t
+		top_k(const KTYPE* prefix,
+			  LTYPE length,
+			  size_t k,
+			  VISITOR visitor) const
+			{
+				assert(prefix || length == 0);
+
+				uint32_t x(0);
+				LTYPE i(0);
+
+				while (i < length) {
+					x = child(r_[x], prefix[i]);
+					if (!x) return 0;
+					++i;
+
+					const Record& r = r_[x];
+					const LTYPE n = std::min((LTYPE)r.l, (LTYPE)(length - i));
+					if (Symbols<KTYPE>::Mismatch(d_ + r.d, prefix + i, n) != n) return 0;
+					i += n;
+				}
+
+				/**
+				 * 探索の候補
+				 */
+				struct Entry
+				{
+					VTYPE s;	///< 得点
+					uint32_t x;	///< ノードの添字
+					bool t;	///< true: ノード自身のキー, false: ノードの子孫
+				};
+
+				auto less = [](const Entry& a, const Entry& b) { return a.s < b.s || (!(b.s < a.s) && !a.t && b.t); };
+
+				std::vector<Entry> h;	// 候補のヒープ
+				std::vector<KTYPE> key;	// 渡すキー
+				std::vector<uint32_t> path;	// 根から渡すノードまでの経路
+				size_t c(0);
+
+				if (r_[x].u != INVALID) {
+					Entry e = {r_[x].u, x, false};
+					h.push_back(e);
+				}
+
+				while (!h.empty() && c < k) {
+					std::pop_heap(h.begin(), h.end(), less);
+					const Entry e = h.back();
+					h.pop_back();
+
+					if (e.t) {
+						path.clear();
+						for (uint32_t y = e.x; y; y = parent(y)) path.push_back(y);
+						key.clear();
+						for (size_t j = path.size(); 0 < j; --j) {
+							const uint32_t y = path[j - 1];
+							key.push_back(s_[y]);
+							key.insert(key.end(), d_ + r_[y].d, d_ + r_[y].d + r_[y].l);
+						}
+
+						++c;
+						if (!visitor(key.data(), (LTYPE)key.size(), e.s)) return c;
+						continue;
+					}
+
+					const Record& r = r_[e.x];
+					if (r.v != INVALID) {
+						Entry t = {r.v, e.x, true};
+						h.push_back(t);
+						std::push_heap(h.begin(), h.end(), less);
+					}
+					for (uint32_t y = r.c; y < r.c + r.n; ++y) {
+						if (r_[y].u == INVALID) continue;
+						Entry t = {r_[y].u, y, false};
+						h.push_back(t);
+						std::push_heap(h.begin(), h.end(), less);
+					}
+				}
+
+				return c;
+			}
+
+		/**
+		 * 全てのキーを昇順に訪問
+		 * @param[in]	visitor	キーを昇順に渡す関数 (引数はキー・キーの長さ・値, false を返すと走査を中止)
+		 * @return	渡したキーの数
+		 * @note	キーの順序は @a PatriciaTrie::Iterator と同じ。
+		 * @note	キーは走査に合わせて1つの配列で組み立てる。
+		 */
+		template<typename VISITOR>
+		size_t
+		for_each(VISITOR visitor) const
+			{
+				std::vector<std::pair<uint32_t, size_t> > s;	// 訪れるノードと親ノードに至るキーの長さ
+				std::vector<KTYPE> key;
+				size_t c(0);
+
+				for (uint32_t i = r_[0].n; 0 < i; --i) s.push_back(std::make_pair(r_[0].c + i - 1, (size_t)0));
+
+				while (!s.empty()) {
+					const uint32_t x = s.back().first;
+					const Record& r = r_[x];
+					key.resize(s.back().second);
+					s.pop_back();
+
+					key.push_back(s_[x]);
+					key.insert(key.end(), d_ + r.d, d_ + r.d + r.l);
+
+					if (r.v != INVALID) {
+						++c;
+						if (!visitor((const KTYPE*)key.data(), (LTYPE)key.size(), r.v)) return c;
+					}
+
+					for (uint32_t i = r.n; 0 < i; --i) s.push_back(std::make_pair(r.c + i - 1, key.size()));
+				}
+
+				return c;
+			}
+
+		/**
+		 * キーを一括で探索 (各キーに対応する値を獲得)
+		 * @param[in]	keys	キー群
+		 * @param[in]	lengths	各キーの要素数
+		 * @param[in]	n	キーの数
+		 * @param[out]	values	各キーに対応する値 (要素数 @a n)
+		 * @note	キーが見つからなかった場合は @a INVALID が格納される。
+		 * @note	@a PatriciaTrie::get_values_batch と同様に、複数のキーの探索を交互に進めて先読みを重ね合わせる。
+		 */
+		void
+		get_values_batch(const KTYPE* const* keys,
+						 const LTYPE* lengths,
+						 size_t n,
+						 VTYPE* values) const
+			{
+				assert(keys);
+				assert(lengths);
+				assert(values);
+
+				/**
+				 * 探索中のキーの状態
+				 */
+				struct State
+				{
+					uint32_t x;	///< 次に照合するノード (0の時は空き)
+					LTYPE i;	///< 照合済みの要素数
+					size_t index;	///< キーの番号
+					bool ready;	///< ノードの内容を先読み済みか否か
+				};
+
+				State s[__PATRICIA_TRIE_BATCH__];
+				size_t m(0);	// 探索を開始したキーの数
+				size_t k(0);	// 探索中のキーの数
+
+				for (size_t i(0); i < __PATRICIA_TRIE_BATCH__; ++i) s[i].x = 0;
+
+				do {
+					k = 0;
+					for (size_t i(0); i < __PATRICIA_TRIE_BATCH__; ++i) {
+						State& t = s[i];
+
+						// 空きに新たなキーを割り当て
+						bool fresh(false);
+						while (!t.x && m < n) {
+							assert(keys[m]);
+							assert(0 < lengths[m]);
+
+							t.x = child(r_[0], keys[m][0]);
+							t.i = 1;
+							t.index = m++;
+							t.ready = false;
+
+							if (t.x) {
+								__PATRICIA_TRIE_PREFETCH__(r_ + t.x);
+								fresh = true;
+							}
+							else {
+								values[t.index] = INVALID;
+							}
+						}
+						if (!t.x) continue;
+						++k;
+
+						// 先読みしたノードの参照は次の周回まで待つ
+						if (fresh) continue;
+
+						const Record& r = r_[t.x];
+
+						if (!t.ready) {
+							// ノードに到着したので、キーと子ノードのキーの値を先読み
+							__PATRICIA_TRIE_PREFETCH__(d_ + r.d);
+							__PATRICIA_TRIE_PREFETCH__(s_ + r.c);
+							t.ready = true;
+							continue;
+						}
+
+						const KTYPE* key = keys[t.index];
+						const LTYPE length = lengths[t.index];
+
+						if (length - t.i < r.l ||
+							Symbols<KTYPE>::Mismatch(d_ + r.d, key + t.i, (LTYPE)r.l) != r.l) {
+							values[t.index] = INVALID;
+							t.x = 0;
+							continue;
+						}
+						t.i += r.l;
+						if (t.i == length) {
+							values[t.index] = r.v;
+							t.x = 0;
+							continue;
+						}
+
+						t.x = child(r, key[t.i]);
+						if (!t.x) {
+							values[t.index] = INVALID;
+							continue;
+						}
+						++t.i;
+						t.ready = false;
+						__PATRICIA_TRIE_PREFETCH__(r_ + t.x);
+					}
+				} while (0 < k || m < n);
+			}
+
+		/**
+		 * キーを探索 (キーの有無をチェック)
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	true: キーが見つかった, false: 見つからなかった
+		 */
+		bool
+		find_key(const KTYPE* key,
+				 LTYPE length) const
+			{
+				assert(key);
+				assert(0 < length);
+
+				return get_value(key, length) != INVALID;
+			}
+
+		/**
+		 * ノードの数を取得
+		 * @return	ノードの数 (根を含む)
+		 */
+		size_t
+		node_count() const
+			{
+				return n_;
+			}
+
+		/**
+		 * 使用している領域の大きさを取得
+		 * @return	管理情報・ノード群・キー群のバイト数 (保存したファイルの大きさに等しい)
+		 */
+		size_t
+		bytes() const
+			{
+				return Size(n_, m_);
+			}
+
+		/**
+		 * キーの追加状態を出力
+		 * @param[in,out]	file	出力先
+		 * @note	出力形式は @a PatriciaTrie::print と同じ。
+		 */
+		void
+		print(FILE* file = stdout) const
+			{
+				std::vector<std::pair<uint32_t, size_t> > s;
+				for (uint32_t i = r_[0].n; 0 < i; --i) s.push_back(std::make_pair(r_[0].c + i - 1, (size_t)0));
+
+				while (!s.empty()) {
+					const uint32_t x = s.back().first;
+					const size_t d = s.back().second;
+					const Record& r = r_[x];
+					s.pop_back();
+
+					for (size_t i(0); i < d; ++i) std::fprintf(file, "  ");
+					if (r.v == INVALID) {
+						std::fprintf(file, "<%G> +%lu (-)\n", (double)s_[x], (size_t)r.l);
+					}
+					else {
+						std::fprintf(file, "<%G> +%lu (%lu)\n", (double)s_[x], (size_t)r.l, (size_t)r.v);
+					}
+
+					for (uint32_t i = r.n; 0 < i; --i) s.push_back(std::make_pair(r.c + i - 1, d + 1));
+				}
+			}
+
+		/**
+		 * 値 @a INVALID を取得
+		 * @return	値 @a INVALID
+		 */
+		static VTYPE
+		InvalidValue()
+			{
+				return INVALID;
+			}
+	};
+};
+
+#endif	// __FROZEN_PATRICIA_TRIE_HPP__
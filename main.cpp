@@ -72,5 +72,25 @@ int main()
 		std::printf("[%u] %s\n", i, k[i]);
 	}
 
+	// キー探索 (最長一致)
+	unsigned int l(0);
+	unsigned int x = pt.get_longest_prefix(b, std::strlen(b), &l);
+	if (x != decltype(pt)::InvalidValue()) {
+		std::printf("[%u] %.*s\n", x, (int)l, b);
+	}
+
+	// キーの列挙 (接頭辞「今日」を持つキーを昇順に)
+	const char p[] = "今日";
+	auto r = pt.prefix_range(p, std::strlen(p));
+	for (auto i = r.first; i != r.second; ++i) {
+		std::printf("[%u] %.*s\n", i.value(), (int)i.length(), i.key());
+	}
+
+	// データの走査 (最長一致法, UTF-8 の文字単位)
+	pt.scan<ys::Utf8>(b, std::strlen(b), [&](size_t offset, unsigned int length, unsigned int value) {
+			std::printf("[%u] +%lu %.*s\n", value, offset, (int)length, b + offset);
+			return true;
+		}, ys::SCAN_LONGEST);
+
 	return 0;
 }
@@ -0,0 +1,319 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	patricia_map.hpp
+ * @brief	C++ template library of patricia trie with densely stored values of any type.
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ */
+
+#ifndef	__PATRICIA_MAP_HPP__
+#define	__PATRICIA_MAP_HPP__	"patricia_map.hpp"
+
+#include <cstdio>
+#include <cstdint>
+#include <cassert>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "patricia_trie.hpp"
+
+namespace ys
+{
+	/**
+	 * 値を木の外に格納するパトリシア木
+	 * @note	木のキー末端には値の番号 (32ビット) のみを置き、値そのものは番号順に連続した領域に格納する。
+	 *			値の型に不正値は不要で、ムーブのみ可能な型 (std::unique_ptr 等) も格納できる。
+	 * @note	値の領域は @a BLOCK 個ずつの塊で確保し、再配置しない (値の参照は削除まで有効)。
+	 *			削除した値の番号は再利用する。
+	 * @note	値の型の制約と不正値 (@a INVALID) を除くためのもので、領域は削減しない。
+	 *			内部の木は非末端ノードも含めて全ノードに値の番号の欄を持ち、加えて番号毎の使用状況・再利用できる番号の配列を持つ。
+	 * @note	登録できるキーの数は 2^32 - 1 未満。
+	 * @note	テンプレートのパラメータ @a KTYPE, @a LTYPE, @a ALLOCATOR は @a PatriciaTrie と同じ。
+	 *			@a VTYPE には任意の値の型を与える。
+	 */
+	template<typename KTYPE, typename LTYPE, typename VTYPE, typename ALLOCATOR = ArenaAllocator>
+	class PatriciaMap
+	{
+	private:
+
+		typedef PatriciaTrie<KTYPE, LTYPE, uint32_t, ~(uint32_t)0, ALLOCATOR> Index;	///< キーから値の番号への木
+		typedef typename std::aligned_storage<sizeof(VTYPE), std::alignment_of<VTYPE>::value>::type Slot;	///< 値の領域
+
+		enum {
+			BITS = 10,	///< 塊内の位置のビット数
+			BLOCK = 1 << BITS	///< 塊毎の値の数
+		};
+
+		Index t_;	///< キーから値の番号への木
+		std::vector<Slot*> b_;	///< 値の塊
+		std::vector<bool> u_;	///< 値の番号毎の使用中か否か
+		std::vector<uint32_t> f_;	///< 再利用できる値の番号
+		uint32_t n_;	///< 割り当てた値の番号の上限
+		size_t c_;	///< 格納している値の数
+
+		/**
+		 * 値の領域を取得
+		 * @param[in]	i	値の番号
+		 * @return	値の領域
+		 */
+		VTYPE*
+		at(uint32_t i) const
+			{
+				return (VTYPE*)(b_[i >> BITS] + (i & (BLOCK - 1)));
+			}
+
+		/**
+		 * 値の番号を確保
+		 * @return	値の番号 (領域は未構築)
+		 * @note	解放済みの番号の配列は容量を確保するので、@a release は領域を確保しない。
+		 */
+		uint32_t
+		acquire()
+			{
+				if (!f_.empty()) {
+					uint32_t i = f_.back();
+					f_.pop_back();
+					return i;
+				}
+
+				if ((size_t)n_ == b_.size() * BLOCK) {
+					// 例外が起きても状態が壊れないように、塊の追加以外の領域を先に確保
+					u_.resize((b_.size() + 1) * BLOCK, false);
+					f_.reserve(u_.size());
+					b_.reserve(b_.size() + 1);
+					b_.push_back(new Slot[BLOCK]);
+				}
+
+				return n_++;
+			}
+
+		/**
+		 * 値の番号を解放
+		 * @param[in]	i	値の番号 (領域は破棄済み)
+		 */
+		void
+		release(uint32_t i)
+			{
+				u_[i] = false;
+				f_.push_back(i);
+			}
+
+		/**
+		 * 値を構築してキーに対応付け
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @param[in]	args	値のコンストラクタの引数
+		 * @return	構築した値
+		 * @note	同じキーの値がある時は、新たな値の構築後に古い値を破棄する。
+		 */
+		template<typename... ARGS>
+		VTYPE&
+		construct(const KTYPE* key,
+				  LTYPE length,
+				  ARGS&&... args)
+			{
+				const uint32_t o = t_.get_value(key, length);
+				const uint32_t i = acquire();
+
+				try {
+					new((void*)at(i)) VTYPE(std::forward<ARGS>(args)...);
+				}
+				catch (...) {
+					f_.push_back(i);
+					throw;
+				}
+				u_[i] = true;
+
+				try {
+					t_.add_key(key, length, i);
+				}
+				catch (...) {
+					at(i)->~VTYPE();
+					release(i);
+					throw;
+				}
+
+				if (o != Index::InvalidValue()) {
+					at(o)->~VTYPE();
+					release(o);
+				}
+				else {
+					++c_;
+				}
+
+				return *at(i);
+			}
+
+	public:
+
+		/**
+		 * コンストラクタ
+		 */
+		PatriciaMap()
+			: t_(), b_(), u_(), f_(), n_(0), c_(0)
+			{
+				;
+			}
+
+		/**
+		 * コピー・コンストラクタ (使用禁止)
+		 */
+		PatriciaMap(const PatriciaMap<KTYPE, LTYPE, VTYPE, ALLOCATOR>&) = delete;
+
+		/**
+		 * 代入演算子 (使用禁止)
+		 */
+		PatriciaMap&
+		operator =(const PatriciaMap<KTYPE, LTYPE, VTYPE, ALLOCATOR>&) = delete;
+
+		/**
+		 * デストラクタ
+		 */
+		virtual
+		~PatriciaMap()
+			{
+				for (uint32_t i(0); i < n_; ++i) {
+					if (u_[i]) at(i)->~VTYPE();
+				}
+				for (auto b : b_) delete [] b;
+			}
+
+		/**
+		 * キーを追加
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @param[in]	value	キー @a key に対応する値 (ムーブする)
+		 * @return	格納した値
+		 * @note	同じキーの値がある時は置き換える。
+		 */
+		VTYPE&
+		add_key(const KTYPE* key,
+				LTYPE length,
+				VTYPE value)
+			{
+				return construct(key, length, std::move(value));
+			}
+
+		/**
+		 * キーを追加 (値をその場で構築)
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @param[in]	args	値のコンストラクタの引数
+		 * @return	格納した値
+		 * @note	同じキーの値がある時は置き換える。
+		 */
+		template<typename... ARGS>
+		VTYPE&
+		emplace(const KTYPE* key,
+				LTYPE length,
+				ARGS&&... args)
+			{
+				return construct(key, length, std::forward<ARGS>(args)...);
+			}
+
+		/**
+		 * キーを削除
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	true: 削除した, false: キーが見つからなかった
+		 * @note	キーに対応する値を破棄する。
+		 */
+		bool
+		remove_key(const KTYPE* key,
+				   LTYPE length)
+			{
+				const uint32_t i = t_.remove_key(key, length);
+				if (i == Index::InvalidValue()) return false;
+
+				at(i)->~VTYPE();
+				release(i);
+				--c_;
+				return true;
+			}
+
+		/**
+		 * キーを探索 (キーに対応する値を獲得)
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	キー @a key に対応する値 (見つからなかった時は0)
+		 */
+		VTYPE*
+		get_value(const KTYPE* key,
+				  LTYPE length)
+			{
+				const uint32_t i = t_.get_value(key, length);
+				return i != Index::InvalidValue() ? at(i) : 0;
+			}
+
+		/**
+		 * キーを探索 (キーに対応する値を獲得)
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	キー @a key に対応する値 (見つからなかった時は0)
+		 */
+		const VTYPE*
+		get_value(const KTYPE* key,
+				  LTYPE length) const
+			{
+				const uint32_t i = t_.get_value(key, length);
+				return i != Index::InvalidValue() ? at(i) : 0;
+			}
+
+		/**
+		 * キーを探索 (共通接頭辞探索, 接頭辞となるキーの値を短い順に訪問)
+		 * @param[in]	buffer	探索対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[in]	visitor	接頭辞となるキーが見つかる度に呼び出す関数 (引数は値・キーの長さ, false を返すと探索を中止)
+		 * @note	テンプレートのパラメータ @a CODE は @a PatriciaTrie::get_values と同じ。
+		 */
+		template<typename CODE = Elements<KTYPE>, typename VISITOR>
+		void
+		get_values(const KTYPE* buffer,
+				   LTYPE length,
+				   VISITOR visitor)
+			{
+				t_.template get_values<CODE>(buffer, length, [&](uint32_t i, LTYPE l) { return visitor(*at(i), l); });
+			}
+
+		/**
+		 * キーを探索 (共通接頭辞探索, 接頭辞となるキーの値を短い順に訪問)
+		 * @param[in]	buffer	探索対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[in]	visitor	接頭辞となるキーが見つかる度に呼び出す関数 (引数は値・キーの長さ, false を返すと探索を中止)
+		 * @note	テンプレートのパラメータ @a CODE は @a PatriciaTrie::get_values と同じ。
+		 */
+		template<typename CODE = Elements<KTYPE>, typename VISITOR>
+		void
+		get_values(const KTYPE* buffer,
+				   LTYPE length,
+				   VISITOR visitor) const
+			{
+				t_.template get_values<CODE>(buffer, length, [&](uint32_t i, LTYPE l) { return visitor((const VTYPE&)*at(i), l); });
+			}
+
+		/**
+		 * キーを探索 (キーの有無をチェック)
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	true: キーが見つかった, false: 見つからなかった
+		 */
+		bool
+		find_key(const KTYPE* key,
+				 LTYPE length) const
+			{
+				return t_.find_key(key, length);
+			}
+
+		/**
+		 * 格納している値の数を取得
+		 * @return	値の数
+		 */
+		size_t
+		size() const
+			{
+				return c_;
+			}
+	};
+};
+
+#endif	// __PATRICIA_MAP_HPP__
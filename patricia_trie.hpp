@@ -14,23 +14,970 @@
 
 #include <cstdio>
 #include <cstring>
+#include <cstdint>
 #include <cassert>
-#include <unordered_map>
+#include <new>
+#include <type_traits>
+#include <algorithm>
 #include <vector>
 #include <utility>
+#include <atomic>
+#include <thread>
+#include "patricia_trie_simd.hpp"
+
+#if	defined(__GNUC__) || defined(__clang__)
+#define	__PATRICIA_TRIE_PREFETCH__(p)	__builtin_prefetch((const void*)(p))
+#else
+#define	__PATRICIA_TRIE_PREFETCH__(p)	((void)0)
+#endif
+
+/**
+ * 一括探索で並行して進めるキーの数
+ */
+#ifndef	__PATRICIA_TRIE_BATCH__
+#define	__PATRICIA_TRIE_BATCH__	16
+#endif
 
 namespace ys
 {
+	/**
+	 * 領域確保の方針 (ヒープを直接利用)
+	 * @note	領域確保の方針は BulkRelease, allocate, deallocate, splice を持ち、既定のコンストラクタで生成できること。
+	 */
+	class HeapAllocator
+	{
+	public:
+
+		/**
+		 * 確保した領域を個別に解放せず一括で解放できるか否か
+		 * @return	true: 一括解放できる, false: 個別に解放する必要がある
+		 */
+		static bool
+		BulkRelease()
+			{
+				return false;
+			}
+
+		/**
+		 * 領域を確保
+		 * @param[in]	size	バイト数
+		 * @return	確保した領域
+		 */
+		void*
+		allocate(size_t size)
+			{
+				return ::operator new(size);
+			}
+
+		/**
+		 * 領域を解放
+		 * @param[in]	pointer	確保した領域
+		 * @param[in]	size	確保時のバイト数
+		 */
+		void
+		deallocate(void* pointer,
+				   size_t size)
+			{
+				(void)size;
+				::operator delete(pointer);
+			}
+
+		/**
+		 * 別のアロケータが確保した領域を引き継ぐ
+		 * @param[in,out]	other	引き継ぎ元のアロケータ
+		 * @note	ヒープの領域はどのアロケータからも解放できるので、何もしない。
+		 */
+		void
+		splice(HeapAllocator& other)
+			{
+				(void)other;
+			}
+	};
+
+	/**
+	 * 領域確保の方針 (アリーナ)
+	 * @note	大きな塊から順に領域を切り出し、解放された領域は大きさ毎の空きリストで再利用する。
+	 * @note	全ての領域はデストラクタで塊単位に解放する。
+	 */
+	class ArenaAllocator
+	{
+	private:
+
+		enum {
+			ALIGN = 8,				///< 切り出す領域の境界
+			CLASSES = 512,			///< 空きリストで管理する大きさの区分数 (ALIGN バイト刻み)
+			MIN_CHUNK = 4096,		///< 最初の塊のバイト数
+			MAX_CHUNK = 1048576		///< 塊のバイト数の上限
+		};
+
+		/**
+		 * 塊の先頭に置く管理情報
+		 */
+		struct Chunk
+		{
+			Chunk* next;	///< 次の塊
+			Chunk* prev;	///< 前の塊 (個別に解放する塊のみ)
+		};
+
+		Chunk* chunks_;	///< 切り出し用の塊
+		Chunk* large_;	///< 個別に解放する大きな領域
+		char* p_;	///< 切り出し位置
+		char* e_;	///< 切り出し中の塊の終端
+		size_t s_;	///< 次に確保する塊のバイト数
+		void* f_[CLASSES];	///< 空きリスト
+
+		/**
+		 * バイト数を境界に合わせて切り上げ
+		 * @param[in]	size	バイト数
+		 * @return	切り上げたバイト数
+		 */
+		static size_t
+		Round(size_t size)
+			{
+				return (size + (ALIGN - 1)) & ~(size_t)(ALIGN - 1);
+			}
+
+		/**
+		 * 新たな塊を確保
+		 * @param[in]	size	必要なバイト数
+		 */
+		void
+		grow(size_t size)
+			{
+				size_t n = s_;
+				while (n < size + sizeof(Chunk)) n *= 2;
+				if (s_ < MAX_CHUNK) s_ *= 2;
+
+				Chunk* c = (Chunk*)::operator new(n);
+				c->next = chunks_;
+				c->prev = 0;
+				chunks_ = c;
+				p_ = (char*)(c + 1);
+				e_ = (char*)c + n;
+			}
+
+	public:
+
+		/**
+		 * コンストラクタ
+		 */
+		ArenaAllocator()
+			: chunks_(0), large_(0), p_(0), e_(0), s_(MIN_CHUNK), f_()
+			{
+				;
+			}
+
+		/**
+		 * コピー・コンストラクタ (使用禁止)
+		 */
+		ArenaAllocator(const ArenaAllocator&) = delete;
+
+		/**
+		 * 代入演算子 (使用禁止)
+		 */
+		ArenaAllocator&
+		operator =(const ArenaAllocator&) = delete;
+
+		/**
+		 * デストラクタ
+		 */
+		~ArenaAllocator()
+			{
+				while (chunks_) {
+					Chunk* c = chunks_->next;
+					::operator delete((void*)chunks_);
+					chunks_ = c;
+				}
+				while (large_) {
+					Chunk* c = large_->next;
+					::operator delete((void*)large_);
+					large_ = c;
+				}
+			}
+
+		/**
+		 * 確保した領域を個別に解放せず一括で解放できるか否か
+		 * @return	true: 一括解放できる, false: 個別に解放する必要がある
+		 */
+		static bool
+		BulkRelease()
+			{
+				return true;
+			}
+
+		/**
+		 * 領域を確保
+		 * @param[in]	size	バイト数
+		 * @return	確保した領域
+		 */
+		void*
+		allocate(size_t size)
+			{
+				size = Round(size);
+				size_t k = size / ALIGN;
+
+				if (CLASSES <= k) {
+					Chunk* c = (Chunk*)::operator new(sizeof(Chunk) + size);
+					c->next = large_;
+					c->prev = 0;
+					if (large_) large_->prev = c;
+					large_ = c;
+					return (void*)(c + 1);
+				}
+
+				if (f_[k]) {
+					void* r = f_[k];
+					f_[k] = *(void**)r;
+					return r;
+				}
+
+				if ((size_t)(e_ - p_) < size) grow(size);
+				void* r = (void*)p_;
+				p_ += size;
+				return r;
+			}
+
+		/**
+		 * 領域を解放
+		 * @param[in]	pointer	確保した領域
+		 * @param[in]	size	確保時のバイト数
+		 * @note	解放した領域は同じ大きさの確保で再利用する。
+		 */
+		void
+		deallocate(void* pointer,
+				   size_t size)
+			{
+				if (!pointer) return;
+
+				size = Round(size);
+				size_t k = size / ALIGN;
+
+				if (CLASSES <= k) {
+					Chunk* c = (Chunk*)pointer - 1;
+					if (c->prev) c->prev->next = c->next;
+					else large_ = c->next;
+					if (c->next) c->next->prev = c->prev;
+					::operator delete((void*)c);
+					return;
+				}
+
+				*(void**)pointer = f_[k];
+				f_[k] = pointer;
+			}
+
+		/**
+		 * 別のアロケータが確保した領域を引き継ぐ
+		 * @param[in,out]	other	引き継ぎ元のアロケータ (空になる)
+		 * @note	塊・大きな領域・空きリストを連結するのみで、領域は複写しない。
+		 *			引き継いだ領域は、このアロケータから解放できる。
+		 */
+		void
+		splice(ArenaAllocator& other)
+			{
+				if (&other == this) return;
+
+				if (other.chunks_) {
+					// 切り出し中の塊は変えず、引き継いだ塊は2番目以降に置く
+					Chunk* c = other.chunks_;
+					while (c->next) c = c->next;
+					if (chunks_) {
+						c->next = chunks_->next;
+						chunks_->next = other.chunks_;
+					}
+					else {
+						chunks_ = other.chunks_;
+						p_ = other.p_;
+						e_ = other.e_;
+					}
+				}
+
+				if (other.large_) {
+					Chunk* c = other.large_;
+					while (c->next) c = c->next;
+					c->next = large_;
+					if (large_) large_->prev = c;
+					large_ = other.large_;
+				}
+
+				for (size_t k(0); k < CLASSES; ++k) {
+					if (!other.f_[k]) continue;
+					void* r = other.f_[k];
+					while (*(void**)r) r = *(void**)r;
+					*(void**)r = f_[k];
+					f_[k] = other.f_[k];
+					other.f_[k] = 0;
+				}
+
+				s_ = std::max(s_, other.s_);
+				other.chunks_ = 0;
+				other.large_ = 0;
+				other.p_ = 0;
+				other.e_ = 0;
+				other.s_ = MIN_CHUNK;
+			}
+	};
+
+	/**
+	 * 探索の計測で数える事象
+	 */
+	enum CountEvent {
+		COUNT_OPERATION,	///< 探索の回数 (@a get_value, @a get_values の呼び出し)
+		COUNT_EDGE,	///< 辿ったノードの数 (ポインタの参照)
+		COUNT_LABEL,	///< 比較したキーの全体のバイト数
+		COUNT_DIRECT,	///< 直接参照表による子ノードの探索の回数
+		COUNT_LINEAR,	///< 線形探索による子ノードの探索の回数
+		COUNT_BINARY,	///< 二分探索による子ノードの探索の回数 (キャッシュ・ミスを伴いやすい)
+		COUNT_CACHE_HIT,	///< 探索結果のキャッシュの命中の回数 (@a CachedPatriciaTrie)
+		COUNT_CACHE_MISS,	///< 探索結果のキャッシュの失敗の回数 (@a CachedPatriciaTrie)
+		COUNT_CACHE_BYPASS,	///< 探索結果のキャッシュに格納できない長さのキーの探索の回数 (@a CachedPatriciaTrie)
+		COUNT_EVENTS	///< 事象の種類数
+	};
+
+	/**
+	 * 探索の計測の方針 (計測しない)
+	 * @note	計測の方針は静的メンバ関数 Count を持つこと。
+	 *			この方針では全ての呼び出しが空になり、最適化で取り除かれる。
+	 */
+	class NoCounter
+	{
+	public:
+
+		/**
+		 * 事象を数える
+		 * @param[in]	event	事象
+		 * @param[in]	n	回数
+		 */
+		static void
+		Count(CountEvent event,
+			  size_t n = 1)
+			{
+				(void)event;
+				(void)n;
+			}
+	};
+
+	/**
+	 * 探索の計測の方針 (スレッド毎に計測)
+	 * @note	スレッド毎の計数器に加算するので、探索を並行に行っても計数器を共有しない。
+	 */
+	class ThreadCounter
+	{
+	public:
+
+		/**
+		 * 呼び出したスレッドの計数器を取得
+		 * @return	事象毎の回数
+		 */
+		static uint64_t*
+		Counts()
+			{
+				static thread_local uint64_t counts[COUNT_EVENTS];
+				return counts;
+			}
+
+		/**
+		 * 事象を数える
+		 * @param[in]	event	事象
+		 * @param[in]	n	回数
+		 */
+		static void
+		Count(CountEvent event,
+			  size_t n = 1)
+			{
+				Counts()[event] += n;
+			}
+
+		/**
+		 * 呼び出したスレッドの計数器を取得
+		 * @param[in]	event	事象
+		 * @return	回数
+		 */
+		static uint64_t
+		Get(CountEvent event)
+			{
+				return Counts()[event];
+			}
+
+		/**
+		 * 呼び出したスレッドの計数器を初期化
+		 */
+		static void
+		Reset()
+			{
+				std::memset((void*)Counts(), 0, sizeof(uint64_t) * COUNT_EVENTS);
+			}
+	};
+
+	/**
+	 * データの走査の方式
+	 */
+	enum ScanMode {
+		SCAN_ALL,	///< 各位置から始まる全てのキーを報告
+		SCAN_LONGEST	///< 各位置で最長のキーのみを報告し、その直後から走査を続ける (最長一致法)
+	};
+
+	/**
+	 * キーの要素列の区切りの方針 (全ての要素の間で区切る)
+	 */
+	template<typename K_>
+	class Elements
+	{
+	public:
+
+		/**
+		 * 位置が区切りか否か
+		 * @param[in]	buffer	データ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[in]	i	位置 (@a length 以下)
+		 * @return	true: 区切り, false: 区切りではない
+		 */
+		static bool
+		Boundary(const K_* buffer,
+				 size_t length,
+				 size_t i)
+			{
+				(void)buffer;
+				(void)length;
+				(void)i;
+				return true;
+			}
+
+		/**
+		 * 次の区切りを取得
+		 * @param[in]	buffer	データ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[in]	i	位置 (@a length 未満)
+		 * @return	位置 @a i より後ろの最初の区切り (区切りがない時は @a length)
+		 */
+		static size_t
+		Next(const K_* buffer,
+			 size_t length,
+			 size_t i)
+			{
+				(void)buffer;
+				(void)length;
+				return i + 1;
+			}
+	};
+
+	/**
+	 * キーの要素列の区切りの方針 (UTF-8 の符号位置の間でのみ区切る)
+	 * @note	1バイトの要素 (char, unsigned char 等) にのみ用いる。
+	 * @note	後続バイト (0x80〜0xBF) の直前以外を区切りとみなすので、不正なバイト列も1バイトずつ区切る。
+	 */
+	class Utf8
+	{
+	public:
+
+		/**
+		 * 位置が区切りか否か
+		 * @param[in]	buffer	データ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[in]	i	位置 (@a length 以下)
+		 * @return	true: 区切り, false: 区切りではない
+		 */
+		template<typename K_>
+		static bool
+		Boundary(const K_* buffer,
+				 size_t length,
+				 size_t i)
+			{
+				static_assert(sizeof(K_) == 1, "UTF-8 requires 1-byte elements.");
+
+				return i == length || ((unsigned char)buffer[i] & 0xC0) != 0x80;
+			}
+
+		/**
+		 * 次の区切りを取得
+		 * @param[in]	buffer	データ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[in]	i	位置 (@a length 未満)
+		 * @return	位置 @a i より後ろの最初の区切り (区切りがない時は @a length)
+		 * @note	後続バイトは最大3つまでしか読み飛ばさない。
+		 */
+		template<typename K_>
+		static size_t
+		Next(const K_* buffer,
+			 size_t length,
+			 size_t i)
+			{
+				static_assert(sizeof(K_) == 1, "UTF-8 requires 1-byte elements.");
+
+#if	defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+				if (4 <= length - i) {
+					// 4バイトをまとめて読み、後続バイトの位置を0とした値から最初の区切りを求める
+					uint32_t x;
+					std::memcpy((void*)&x, (const void*)(buffer + i), 4);
+					x = ((x & 0xC0C0C0C0) ^ 0x80808080) & 0xFFFFFF00;
+					if (!x) return i + 4;
+#if	defined(__GNUC__) || defined(__clang__)
+					return i + (size_t)(__builtin_ctz(x) / 8);
+#endif
+				}
+#endif
+
+				const size_t e = std::min(length, i + 4);
+				for (++i; i < e && ((unsigned char)buffer[i] & 0xC0) == 0x80; ++i) ;
+				return i;
+			}
+	};
+
+	template<typename KTYPE, typename LTYPE, typename VTYPE, VTYPE INVALID>
+	class FrozenPatriciaTrie;
+
+	template<typename KTYPE, typename LTYPE, typename VTYPE, VTYPE INVALID>
+	class AhoCorasick;
+
 	/**
 	 * パトリシア木
 	 * @note	テンプレートのパラメータ @a LTYPE には、符号なし整数を与えること。
 	 * @note	テンプレートのパラメータ @a INVALID には、@a VTYPE の不正値を与えること。
+	 * @note	テンプレートのパラメータ @a ALLOCATOR には、ノード・子ノードの表・キーの領域の確保方針を与えること。
+	 * @note	テンプレートのパラメータ @a COUNTER には、探索の計測の方針 (@a NoCounter, @a ThreadCounter) を与えること。
 	 */
-	template<typename KTYPE, typename LTYPE, typename VTYPE, VTYPE INVALID = ~(VTYPE)0>
+	template<typename KTYPE, typename LTYPE, typename VTYPE, VTYPE INVALID = ~(VTYPE)0, typename ALLOCATOR = ArenaAllocator, typename COUNTER = NoCounter>
 	class PatriciaTrie
 	{
+		static_assert(std::is_integral<KTYPE>::value, "KTYPE must be an integral type.");
+
+		template<typename K_, typename L_, typename V_, V_ I_>
+		friend class FrozenPatriciaTrie;
+
+		template<typename K_, typename L_, typename V_, V_ I_>
+		friend class AhoCorasick;
+
 	private:
 
+		/**
+		 * 子ノードの表
+		 * @note	子ノードが少ない間はキーで整列した小さな配列 (4, 16, 48要素) を用い、
+		 *			それを超えると1バイトのキーでは256要素の直接参照表に、
+		 *			それ以外のキーでは容量を倍々に伸ばす整列済みの配列に切り替える。
+		 * @note	キーの順序は符号なし整数として比較した順序とする。
+		 */
+		template<typename K_, typename N_>
+		class Children
+		{
+		private:
+
+			typedef typename std::make_unsigned<K_>::type U_;	///< 比較に用いる型
+
+			/**
+			 * 表の先頭に置く管理情報
+			 */
+			struct Header
+			{
+				uint32_t n;	///< 子ノードの数
+				uint32_t m;	///< 配列の容量 (0の時は直接参照表)
+			};
+
+			Header* h_;	///< 表の実体 (0を許す)
+
+			/**
+			 * 直接参照表を使うか否か
+			 * @return	true: 使う, false: 使わない
+			 */
+			static bool
+			Direct()
+				{
+					return sizeof(K_) == 1;
+				}
+
+			/**
+			 * 子ノードの配列の位置を計算
+			 * @param[in]	m	配列の容量
+			 * @return	表の先頭からのバイト数
+			 */
+			static size_t
+			Offset(uint32_t m)
+				{
+					return (sizeof(Header) + sizeof(K_) * m + sizeof(N_*) - 1) / sizeof(N_*) * sizeof(N_*);
+				}
+
+			/**
+			 * 表の大きさを計算
+			 * @param[in]	m	配列の容量 (0の時は直接参照表)
+			 * @return	表のバイト数
+			 */
+			static size_t
+			Bytes(uint32_t m)
+				{
+					return m ? Offset(m) + sizeof(N_*) * m : sizeof(Header) + sizeof(N_*) * 256;
+				}
+
+			/**
+			 * 伸長後の容量を計算
+			 * @param[in]	m	現在の容量
+			 * @return	伸長後の容量 (0の時は直接参照表)
+			 */
+			static uint32_t
+			Grow(uint32_t m)
+				{
+					if (m < 16) return 16;
+					if (m < 48) return 48;
+					if (m == 48 && Direct()) return 0;
+					return m * 2;
+				}
+
+			/**
+			 * 表を生成
+			 * @param[in,out]	allocator	領域の確保に用いるアロケータ
+			 * @param[in]	m	配列の容量 (0の時は直接参照表)
+			 * @return	空の表
+			 */
+			static Header*
+			Create(ALLOCATOR& allocator,
+				   uint32_t m)
+				{
+					Header* h = (Header*)allocator.allocate(Bytes(m));
+					h->n = 0;
+					h->m = m;
+					if (!m) std::memset((void*)(h + 1), 0, sizeof(N_*) * 256);
+					return h;
+				}
+
+			/**
+			 * キーの配列を取得
+			 * @return	キーの配列
+			 */
+			K_*
+			keys() const
+				{
+					return (K_*)(h_ + 1);
+				}
+
+			/**
+			 * 子ノードの配列を取得
+			 * @return	子ノードの配列
+			 */
+			N_**
+			nodes() const
+				{
+					return h_->m ? (N_**)((char*)h_ + Offset(h_->m)) : (N_**)(h_ + 1);
+				}
+
+			/**
+			 * 整列済みの配列からキーの挿入位置を探索
+			 * @param[in]	k	キー
+			 * @return	キー @a k 以上の最初の位置
+			 */
+			uint32_t
+			lower(K_ k) const
+				{
+					const K_* keys = this->keys();
+					uint32_t i(0);
+					uint32_t j = h_->n;
+
+					while (i < j) {
+						uint32_t c = (i + j) / 2;
+						if ((U_)keys[c] < (U_)k) i = c + 1;
+						else j = c;
+					}
+
+					return i;
+				}
+
+			/**
+			 * 容量を変更
+			 * @param[in,out]	allocator	領域の確保に用いるアロケータ
+			 * @param[in]	m	変更後の容量 (0の時は直接参照表)
+			 */
+			void
+			resize(ALLOCATOR& allocator,
+				   uint32_t m)
+				{
+					Children<K_, N_> t;
+					t.h_ = Create(allocator, m);
+
+					for (uint32_t i(0), e = end(); i < e; ++i) {
+						N_* c = node_at(i);
+						if (c) t.insert(allocator, key_at(i), c);
+					}
+
+					release(allocator);
+					h_ = t.h_;
+					t.h_ = 0;
+				}
+
+		public:
+
+			/**
+			 * コンストラクタ
+			 */
+			Children()
+				: h_(0)
+				{
+					;
+				}
+
+			/**
+			 * コピー・コンストラクタ (使用禁止)
+			 */
+			Children(const Children<K_, N_>&) = delete;
+
+			/**
+			 * 代入演算子 (使用禁止)
+			 */
+			Children&
+			operator =(const Children<K_, N_>&) = delete;
+
+			/**
+			 * 表を解放
+			 * @param[in,out]	allocator	表の確保に用いたアロケータ
+			 * @note	子ノード自体は解放しない。
+			 */
+			void
+			release(ALLOCATOR& allocator)
+				{
+					if (h_) allocator.deallocate((void*)h_, Bytes(h_->m));
+					h_ = 0;
+				}
+
+			/**
+			 * 子ノードの数を取得
+			 * @return	子ノードの数
+			 */
+			size_t
+			size() const
+				{
+					return h_ ? h_->n : 0;
+				}
+
+			/**
+			 * 表のバイト数を取得
+			 * @return	確保した表のバイト数 (表がない時は0)
+			 */
+			size_t
+			bytes() const
+				{
+					return h_ ? Bytes(h_->m) : 0;
+				}
+
+			/**
+			 * 走査位置の終端を取得
+			 * @return	走査位置の終端
+			 * @note	@a node_at と @a key_at は 0 以上この値未満の位置を受け付ける。
+			 */
+			uint32_t
+			end() const
+				{
+					if (!h_) return 0;
+					return h_->m ? h_->n : 256;
+				}
+
+			/**
+			 * 走査位置の子ノードを取得
+			 * @param[in]	i	走査位置
+			 * @return	子ノード (直接参照表の空きの時は0)
+			 */
+			N_*
+			node_at(uint32_t i) const
+				{
+					assert(i < end());
+
+					return nodes()[i];
+				}
+
+			/**
+			 * 走査位置のキーを取得
+			 * @param[in]	i	走査位置
+			 * @return	子ノードに至るキー
+			 */
+			K_
+			key_at(uint32_t i) const
+				{
+					assert(i < end());
+
+					return h_->m ? keys()[i] : (K_)(U_)i;
+				}
+
+			/**
+			 * 表をキャッシュに先読み
+			 */
+			void
+			prefetch() const
+				{
+					if (h_) __PATRICIA_TRIE_PREFETCH__(h_);
+				}
+
+			/**
+			 * 子ノードを探索
+			 * @param[in]	k	キー
+			 * @return	子ノード (見つからなかった時は0)
+			 */
+			N_*
+			find(K_ k) const
+				{
+					if (!h_) return 0;
+					if (!h_->m) {
+						COUNTER::Count(COUNT_DIRECT);
+						return nodes()[(U_)k];
+					}
+
+					const K_* keys = this->keys();
+					const uint32_t n = h_->n;
+
+					if (h_->m <= Symbols<K_>::Span()) {
+						COUNTER::Count(COUNT_LINEAR);
+						uint32_t i = Symbols<K_>::Find(keys, n, k);
+						return i < n ? nodes()[i] : 0;
+					}
+
+					COUNTER::Count(COUNT_BINARY);
+					uint32_t i = lower(k);
+					return (i < n && keys[i] == k) ? nodes()[i] : 0;
+				}
+
+			/**
+			 * キー以上の最初の走査位置を取得
+			 * @param[in]	k	キー
+			 * @return	走査位置 (@a end 以下, 直接参照表の時は空きの位置を含む)
+			 */
+			uint32_t
+			position(K_ k) const
+				{
+					if (!h_) return 0;
+					return h_->m ? lower(k) : (uint32_t)(U_)k;
+				}
+
+			/**
+			 * 子ノードを格納する場所を探索
+			 * @param[in]	k	キー
+			 * @return	子ノードを格納する場所 (見つからなかった時は0)
+			 */
+			N_**
+			slot(K_ k)
+				{
+					if (!h_) return 0;
+					if (!h_->m) return nodes()[(U_)k] ? nodes() + (U_)k : 0;
+
+					uint32_t i = lower(k);
+					return (i < h_->n && keys()[i] == k) ? nodes() + i : 0;
+				}
+
+			/**
+			 * 子ノードの数に合わせて空の表を確保
+			 * @param[in,out]	allocator	表の確保に用いるアロケータ
+			 * @param[in]	n	追加する子ノードの数
+			 * @note	表が既に存在する時は何もしない。
+			 */
+			void
+			reserve(ALLOCATOR& allocator,
+					size_t n)
+				{
+					if (h_ || n == 0) return;
+
+					uint32_t m(4);
+					while (m && m < n) m = Grow(m);
+					h_ = Create(allocator, m);
+				}
+
+			/**
+			 * 子ノードを追加
+			 * @param[in,out]	allocator	表の確保に用いるアロケータ
+			 * @param[in]	k	キー
+			 * @param[in]	node	子ノード
+			 * @note	キー @a k の子ノードは未登録であること。
+			 */
+			void
+			insert(ALLOCATOR& allocator,
+				   K_ k,
+				   N_* node)
+				{
+					assert(node);
+					assert(!find(k));
+
+					if (!h_) {
+						h_ = Create(allocator, 4);
+					}
+					else if (h_->m && h_->n == h_->m) {
+						resize(allocator, Grow(h_->m));
+					}
+
+					if (!h_->m) {
+						nodes()[(U_)k] = node;
+						++h_->n;
+						return;
+					}
+
+					K_* keys = this->keys();
+					N_** nodes = this->nodes();
+					uint32_t i = lower(k);
+					uint32_t n = h_->n;
+
+					std::memmove((void*)(keys + i + 1), (const void*)(keys + i), sizeof(K_) * (n - i));
+					std::memmove((void*)(nodes + i + 1), (const void*)(nodes + i), sizeof(N_*) * (n - i));
+					keys[i] = k;
+					nodes[i] = node;
+					++h_->n;
+				}
+
+			/**
+			 * 子ノードを除去
+			 * @param[in,out]	allocator	表の確保に用いたアロケータ
+			 * @param[in]	k	キー
+			 * @return	除去した子ノード (見つからなかった時は0)
+			 * @note	子ノードが減った時は表を縮小する。
+			 */
+			N_*
+			erase(ALLOCATOR& allocator,
+				  K_ k)
+				{
+					N_** s = slot(k);
+					if (!s) return 0;
+
+					N_* r = *s;
+
+					if (!h_->m) {
+						*s = 0;
+					}
+					else {
+						uint32_t i = (uint32_t)(s - nodes());
+						uint32_t n = h_->n;
+						K_* keys = this->keys();
+						std::memmove((void*)(keys + i), (const void*)(keys + i + 1), sizeof(K_) * (n - i - 1));
+						std::memmove((void*)s, (const void*)(s + 1), sizeof(N_*) * (n - i - 1));
+					}
+
+					if (--h_->n == 0) {
+						release(allocator);
+					}
+					else if (!h_->m) {
+						if (h_->n <= 24) resize(allocator, 48);
+					}
+					else if (4 < h_->m && h_->n * 4 <= h_->m) {
+						resize(allocator, h_->m <= 16 ? 4 : h_->m <= 48 ? 16 : h_->m / 2);
+					}
+
+					return r;
+				}
+		};
+
+		/**
+		 * 整列済みのキー群を指定位置の値で分割
+		 * @param[in]	begin	キー群の先頭
+		 * @param[in]	end	キー群の終端
+		 * @param[in]	d	分割に用いる位置 (全てのキーの長さは @a d より大きいこと)
+		 * @param[out]	groups	分割したキー群 (メンバ @a k, @a b, @a l, @a e のみを設定)
+		 */
+		template<typename ITERATOR, typename WORK>
+		static void
+		Group(ITERATOR begin,
+			  ITERATOR end,
+			  LTYPE d,
+			  std::vector<WORK>& groups)
+			{
+				while (begin != end) {
+					assert(d < (LTYPE)begin->first.size());
+
+					WORK w = {0, begin->first.data()[d], begin, begin, begin, d};
+
+					for (++begin; begin != end && begin->first.data()[d] == w.k; ++begin) w.l = begin;
+					w.e = begin;
+					groups.push_back(w);
+				}
+			}
+
 		/**
 		 * パトリシア木の内部で用いるノード
 		 */
@@ -39,8 +986,9 @@ namespace ys
 		{
 		public:
 
-			std::unordered_map<K_, Node<K_, L_, V_>*>* c_;	///< 子ノード
+			Children<K_, Node<K_, L_, V_> > c_;	///< 子ノード
 			K_* d_;	///< キーの全体 (0を許す)
+			L_ o_;	///< 確保した領域の先頭から @a d_ までの要素数
 			L_ l_;	///< キーの全体の長さ
 			V_ v_;	///< キー末端
 
@@ -48,20 +996,22 @@ namespace ys
 
 			/**
 			 * コンストラクタ
+			 * @param[in,out]	allocator	キーの領域の確保に用いるアロケータ
 			 * @param[in]	key	キー
 			 * @param[in]	length	配列 @a key の要素数
 			 * @param[in]	value	キーに対応した値
 			 * @note	引数 @a value が @a I_ の時は、ノードは非末端。
 			 */
-			Node(const K_* key,
+			Node(ALLOCATOR& allocator,
+				 const K_* key,
 				 L_ length,
 				 V_ value)
-				: c_(0), d_(0), l_(length), v_(value)
+				: c_(), d_(0), o_(0), l_(length), v_(value)
 				{
 					assert(key);
 
 					if (0 < length) {
-						d_ = new K_[length];
+						d_ = (K_*)allocator.allocate(sizeof(K_) * length);
 						std::memcpy((void*)d_, (const void*)key, sizeof(K_) * length);
 					}
 				}
@@ -69,66 +1019,175 @@ namespace ys
 			/**
 			 * キーの全体から先頭を除去
 			 * @param[in]	length	除去する要素数
+			 * @note	領域は再確保せず、参照する範囲のみを縮める。
 			 */
 			void
 			cut_head(L_ length)
 				{
 					assert(length <= l_);
 
+					d_ += length;
+					o_ += length;
 					l_ -= length;
-					if (d_) delete [] d_;
-
-					if (0 < l_) {
-						K_* d = new K_[l_];
-						std::memcpy((void*)d, (const void*)(d_ + length), sizeof(K_) * l_);
-						d_ = d;
-					}
-					else {
-						d_ = 0;
-					}
 				}
 
 		public:
 
 			/**
-			 * デストラクタ
+			 * コピー・コンストラクタ (使用禁止)
+			 */
+			Node(const Node<K_, L_, V_, I_>&) = delete;
+
+			/**
+			 * 代入演算子 (使用禁止)
+			 */
+			Node&
+			operator =(const Node<K_, L_, V_, I_>&) = delete;
+
+			/**
+			 * ノードを生成
+			 * @param[in,out]	allocator	領域の確保に用いるアロケータ
+			 * @param[in]	key	キー
+			 * @param[in]	length	配列 @a key の要素数
+			 * @param[in]	value	キーに対応した値
+			 * @return	生成したノード
+			 * @note	引数 @a value が @a I_ の時は、ノードは非末端。
+			 */
+			static Node<K_, L_, V_>*
+			Create(ALLOCATOR& allocator,
+				   const K_* key,
+				   L_ length,
+				   V_ value)
+				{
+					void* p = allocator.allocate(sizeof(Node<K_, L_, V_>));
+					return new(p) Node<K_, L_, V_>(allocator, key, length, value);
+				}
+
+			/**
+			 * ノードとその子孫を全て解放
+			 * @param[in,out]	allocator	領域の確保に用いたアロケータ
+			 * @param[in]	node	解放対象のノード
 			 */
-			~Node()
+			static void
+			Destroy(ALLOCATOR& allocator,
+					Node<K_, L_, V_>* node)
 				{
-					if (d_) delete [] d_;
+					assert(node);
+
+					std::vector<Node<K_, L_, V_>*> s(1, node);
 
-					if (c_) {
-						for (auto c : *c_) { delete c.second; }
-						delete c_;
+					while (!s.empty()) {
+						node = s.back();
+						s.pop_back();
+
+						for (uint32_t i(0), e = node->c_.end(); i < e; ++i) {
+							Node<K_, L_, V_>* c = node->c_.node_at(i);
+							if (c) s.push_back(c);
+						}
+
+						Release(allocator, node);
 					}
 				}
 
 			/**
-			 * キーを削除
+			 * ノードを1つだけ解放
+			 * @param[in,out]	allocator	領域の確保に用いたアロケータ
+			 * @param[in]	node	解放対象のノード
+			 * @note	子ノードは解放しない。
+			 */
+			static void
+			Release(ALLOCATOR& allocator,
+					Node<K_, L_, V_>* node)
+				{
+					assert(node);
+
+					node->c_.release(allocator);
+					if (node->d_) allocator.deallocate((void*)(node->d_ - node->o_), sizeof(K_) * (node->o_ + node->l_));
+					node->~Node();
+					allocator.deallocate((void*)node, sizeof(Node<K_, L_, V_>));
+				}
+
+			/**
+			 * ノードからキーを削除
+			 * @param[in,out]	allocator	領域の確保に用いたアロケータ
+			 * @param[in,out]	node	削除対象のノード
 			 * @param[in]	key	削除対象のキー
 			 * @param[in]	length	配列 @a key の長さ
-			 * @return	キー @a key に対応した値
-			 * @todo	必要であればエッジの統合を実現する。
+			 * @param[out]	value	キー @a key に対応した値 (見つからなかった時は @a I_)
+			 * @return	削除後のノード (ノードが空になった時は0)
+			 * @note	子ノードのない非末端ノードは解放し、子ノードが1つの非末端ノードは子ノードと統合する。
 			 */
-			V_
-			remove_key(const K_* key,
-					   L_ length)
+			static Node<K_, L_, V_>*
+			Remove(ALLOCATOR& allocator,
+				   Node<K_, L_, V_>* node,
+				   const K_* key,
+				   L_ length,
+				   V_& value)
 				{
+					assert(node);
 					assert(key);
 
-					if (length < l_) return I_;
-					if (std::memcmp((const void*)d_, (const void*)key, sizeof(K_) * l_) != 0) return I_;
-					if (length == l_) {
-						V_ r(v_);
-						v_ = I_;
-						return r;
+					std::vector<std::pair<Node<K_, L_, V_>*, K_> > s;	// 経路上の親ノードと子ノードに至るキー
+					value = I_;
+
+					for (;;) {
+						if (length < node->l_) return s.empty() ? node : s.front().first;
+						if (Symbols<K_>::Mismatch(node->d_, key, node->l_) != node->l_) return s.empty() ? node : s.front().first;
+						if (length == node->l_) break;
+
+						Node<K_, L_, V_>* c = node->c_.find(key[node->l_]);
+						if (!c) return s.empty() ? node : s.front().first;
+
+						s.push_back(std::make_pair(node, key[node->l_]));
+						key += node->l_ + 1;
+						length -= node->l_ + 1;
+						node = c;
 					}
 
-					if (!c_) return I_;
-					auto it = c_->find(key[l_]);
-					if (it == c_->end()) return I_;
+					value = node->v_;
+					if (value == I_) return s.empty() ? node : s.front().first;
+					node->v_ = I_;
+
+					for (;;) {
+						Node<K_, L_, V_>* r(node);	// 親ノードに格納するノード (0の時は除去)
 
-					return it->second->remove_key(key + (l_ + 1), length - (l_ + 1));
+						if (node->v_ == I_ && node->c_.size() == 0) {
+							// 除去
+							Release(allocator, node);
+							r = 0;
+						}
+						else if (node->v_ == I_ && node->c_.size() == 1) {
+							// 統合
+							uint32_t i(0);
+							while (!node->c_.node_at(i)) ++i;
+							Node<K_, L_, V_>* c = node->c_.node_at(i);
+							const L_ l = node->l_ + 1 + c->l_;
+							K_* d = (K_*)allocator.allocate(sizeof(K_) * l);
+							if (0 < node->l_) std::memcpy((void*)d, (const void*)node->d_, sizeof(K_) * node->l_);
+							d[node->l_] = node->c_.key_at(i);
+							if (0 < c->l_) std::memcpy((void*)(d + node->l_ + 1), (const void*)c->d_, sizeof(K_) * c->l_);
+							if (c->d_) allocator.deallocate((void*)(c->d_ - c->o_), sizeof(K_) * (c->o_ + c->l_));
+							c->d_ = d;
+							c->o_ = 0;
+							c->l_ = l;
+							Release(allocator, node);
+							r = c;
+						}
+
+						if (s.empty()) return r;
+
+						Node<K_, L_, V_>* p = s.back().first;
+						const K_ k = s.back().second;
+						s.pop_back();
+
+						if (r) {
+							if (r != node) *p->c_.slot(k) = r;
+							return s.empty() ? p : s.front().first;
+						}
+
+						p->c_.erase(allocator, k);
+						node = p;
+					}
 				}
 
 			/**
@@ -144,70 +1203,98 @@ namespace ys
 				{
 					assert(key);
 
-					if (length < l_) return I_;
-					if (std::memcmp((const void*)d_, (const void*)key, sizeof(K_) * l_) != 0) return I_;
-					if (length == l_) return v_;
+					const Node<K_, L_, V_>* node(this);
 
-					if (!c_) return I_;
-					auto it = c_->find(key[l_]);
-					if (it == c_->end()) return I_;
+					for (;;) {
+						COUNTER::Count(COUNT_EDGE);
+						if (length < node->l_) return I_;
+						COUNTER::Count(COUNT_LABEL, sizeof(K_) * node->l_);
+						if (Symbols<K_>::Mismatch(node->d_, key, node->l_) != node->l_) return I_;
+						if (length == node->l_) return node->v_;
 
-					return it->second->get_value(key + (l_ + 1), length - (l_ + 1));
+						const Node<K_, L_, V_>* c = node->c_.find(key[node->l_]);
+						if (!c) return I_;
+
+						key += node->l_ + 1;
+						length -= node->l_ + 1;
+						node = c;
+					}
 				}
 
 			/**
 			 * ノードを探索 (共通接頭辞探索)
 			 * @param[in]	buffer	探索対象のデータ
 			 * @param[in]	length	配列 @a buffer の長さ
-			 * @param[out]	values	配列 @a buffer の接頭辞となるキーの全ての値
+			 * @param[in]	visitor	接頭辞となるキーが見つかる度に呼び出す関数 (引数は値・キーの長さ, false を返すと探索を中止)
+			 * @param[in]	offset	キーの長さに加える値
 			 */
+			template<typename VISITOR>
 			void
 			get_values(const K_* buffer,
 					   L_ length,
-					   std::vector<V_>& values) const
+					   VISITOR& visitor,
+					   L_ offset) const
 				{
 					assert(buffer);
 
-					if (length < l_) return;
-					if (std::memcmp((const void*)d_, (const void*)buffer, sizeof(K_) * l_) != 0) return;
-					if (v_ != I_) values.push_back(v_);
+					const Node<K_, L_, V_>* node(this);
 
-					if (l_ < length && c_) {
-						auto it = c_->find(buffer[l_]);
-						if (it != c_->end()) {
-							it->second->get_values(buffer + (l_ + 1), length - (l_ + 1), values);
-						}
+					for (;;) {
+						COUNTER::Count(COUNT_EDGE);
+						if (length < node->l_) return;
+						COUNTER::Count(COUNT_LABEL, sizeof(K_) * node->l_);
+						if (Symbols<K_>::Mismatch(node->d_, buffer, node->l_) != node->l_) return;
+						offset += node->l_;
+						if (node->v_ != I_ && !visitor(node->v_, offset)) return;
+						if (length == node->l_) return;
+
+						const Node<K_, L_, V_>* c = node->c_.find(buffer[node->l_]);
+						if (!c) return;
+
+						buffer += node->l_ + 1;
+						length -= node->l_ + 1;
+						offset += 1;
+						node = c;
 					}
 				}
 
 			/**
 			 * ノードの状態を出力
 			 * @param[in,out]	file	出力先
-			 * @param[in]	d	ノードの深さ
+			 * @param[in]	k	ノードに至るキー
 			 * @note	出力形式は「<キーの先頭の値> +キーの長さ (キーに対応する値)」となる。
 			 */
 			void
 			print(FILE* file,
-				  const K_& k,
-				  size_t d = 0) const
+				  const K_& k) const
 				{
-					for (size_t i(0); i < d; ++i) std::fprintf(file, "  ");
-					if (v_ == I_) {
-						std::fprintf(file, "<%G> +%lu (-)\n", (double)k, (size_t)l_);
-					}
-					else {
-						std::fprintf(file, "<%G> +%lu (%lu)\n", (double)k, (size_t)l_, (size_t)v_);
-					}
+					std::vector<std::pair<const Node<K_, L_, V_>*, std::pair<K_, size_t> > > s;
+					s.push_back(std::make_pair(this, std::make_pair(k, (size_t)0)));
 
-					if (c_) {
-						for (auto c : *c_) {
-							c.second->print(file, c.first, d + 1);
+					while (!s.empty()) {
+						const Node<K_, L_, V_>* node = s.back().first;
+						const K_ h = s.back().second.first;
+						const size_t d = s.back().second.second;
+						s.pop_back();
+
+						for (size_t i(0); i < d; ++i) std::fprintf(file, "  ");
+						if (node->v_ == I_) {
+							std::fprintf(file, "<%G> +%lu (-)\n", (double)h, (size_t)node->l_);
+						}
+						else {
+							std::fprintf(file, "<%G> +%lu (%lu)\n", (double)h, (size_t)node->l_, (size_t)node->v_);
+						}
+
+						for (uint32_t i = node->c_.end(); 0 < i; --i) {
+							const Node<K_, L_, V_>* c = node->c_.node_at(i - 1);
+							if (c) s.push_back(std::make_pair(c, std::make_pair(node->c_.key_at(i - 1), d + 1)));
 						}
 					}
 				}
 
 			/**
 			 * ノードにキーを追加
+			 * @param[in,out]	allocator	領域の確保に用いるアロケータ
 			 * @param[in,out]	node	追加対象のノード
 			 * @param[in]	key	キー
 			 * @param[in]	length	配列 @a key の要素数
@@ -217,7 +1304,8 @@ namespace ys
 			 * @todo	メモリ確保失敗時の扱いについて考える。
 			 */
 			static Node<K_, L_, V_>*
-			Add(Node<K_, L_, V_>* node,
+			Add(ALLOCATOR& allocator,
+				Node<K_, L_, V_>* node,
 				const K_* key,
 				L_ length,
 				V_ value = 0)
@@ -225,85 +1313,324 @@ namespace ys
 					assert(key);
 					assert(value != I_);	// 非末端ノードは生成しない
 
-					if (node) {
-						L_ i(0);
+					Node<K_, L_, V_>* r(node);
+					Node<K_, L_, V_>** t(&r);	// 追加後のノードの格納先
+
+					for (;;) {
+						node = *t;
+
+						if (!node) {
+							*t = Create(allocator, key, length, value);
+							return r;
+						}
+
 						L_ n = std::min(node->l_, length);
+						L_ i = Symbols<K_>::Mismatch(node->d_, key, n);
+
+						if (i < n) {
+							// 分離
+							Node<K_, L_, V_>* p = Create(allocator, key, i, I_);
+							p->c_.insert(allocator, node->d_[i], node);
+							node->cut_head(i + 1);
+							p->c_.insert(allocator, key[i], Create(allocator, key + (i + 1), length - (i + 1), value));
+							*t = p;
+							return r;
+						}
+
+						if (node->l_ < length) {
+							// 追加
+							Node<K_, L_, V_>** c = node->c_.slot(key[i]);
+							if (!c) {
+								node->c_.insert(allocator, key[i], Create(allocator, key + (i + 1), length - (i + 1), value));
+								return r;
+							}
+							t = c;
+							key += i + 1;
+							length -= i + 1;
+						}
+						else if (length < node->l_) {
+							// 追加
+							Node<K_, L_, V_>* p = Create(allocator, key, length, value);
+							p->c_.insert(allocator, node->d_[i], node);
+							node->cut_head(i + 1);
+							*t = p;
+							return r;
+						}
+						else {
+							// 更新
+							node->v_ = value;
+							return r;
+						}
+					}
+				}
+		};
+
+		/**
+		 * 構築待ちのノード (先頭から @a d 要素が共通するキー群)
+		 */
+		template<typename ITERATOR>
+		struct Work
+		{
+			Node<KTYPE, LTYPE, VTYPE>* p;	///< 親ノード (0の時は部分木の根)
+			KTYPE k;	///< 親ノードからノードに至るキーの値
+			ITERATOR b;	///< キー群の先頭
+			ITERATOR l;	///< キー群の末尾
+			ITERATOR e;	///< キー群の終端
+			LTYPE d;	///< 共通する要素数
+		};
+
+		/**
+		 * 整列済みのキー群から部分木を構築
+		 * @param[in,out]	allocator	領域の確保に用いるアロケータ
+		 * @param[in]	begin	キー群の先頭
+		 * @param[in]	last	キー群の末尾
+		 * @param[in]	end	キー群の終端
+		 * @param[in]	d	キー群に共通する要素数 (1以上)
+		 * @return	部分木の根 (先頭から @a d 要素を除いたキーの全体を持つ)
+		 */
+		template<typename ITERATOR>
+		static Node<KTYPE, LTYPE, VTYPE>*
+		Build(ALLOCATOR& allocator,
+			  ITERATOR begin,
+			  ITERATOR last,
+			  ITERATOR end,
+			  LTYPE d)
+			{
+				typedef Node<KTYPE, LTYPE, VTYPE> N;
+
+				std::vector<Work<ITERATOR> > s;	// 構築待ちのノード群
+				std::vector<Work<ITERATOR> > g;	// 同じ親ノードを持つノード群
+				N* r(0);
+
+				Work<ITERATOR> w0 = {0, (KTYPE)0, begin, last, end, d};
+				s.push_back(w0);
+
+				while (!s.empty()) {
+					Work<ITERATOR> w = s.back();
+					s.pop_back();
+
+					const KTYPE* f = w.b->first.data();
+					const KTYPE* t = w.l->first.data();
+					const LTYPE n = std::min((LTYPE)w.b->first.size(), (LTYPE)w.l->first.size());
+					const LTYPE p = w.d + Symbols<KTYPE>::Mismatch(f + w.d, t + w.d, (LTYPE)(n - w.d));
+
+					VTYPE v(INVALID);
+					ITERATOR it = w.b;
+					for (; it != w.e && (LTYPE)it->first.size() == p; ++it) {
+						assert(it->second != INVALID);
+						v = it->second;
+					}
+
+					N* node = N::Create(allocator, f + w.d, p - w.d, v);
+					if (w.p) w.p->c_.insert(allocator, w.k, node);
+					else r = node;
+
+					g.clear();
+					Group(it, w.e, p, g);
+					node->c_.reserve(allocator, g.size());
+					for (auto jt = g.rbegin(); jt != g.rend(); ++jt) {
+						s.push_back(*jt);
+						s.back().p = node;
+						s.back().d = p + 1;
+					}
+				}
+
+				return r;
+			}
+
+		ALLOCATOR allocator_;	///< ノード・子ノードの表・キーの領域の確保に用いるアロケータ
+		Children<KTYPE, Node<KTYPE, LTYPE, VTYPE> > head_;	///< ノード群
+
+	public:
+
+		/**
+		 * キーを昇順に走査する反復子
+		 * @note	キーは要素を符号なし整数とみなした辞書順に並ぶ。
+		 * @note	キーは走査に合わせて内部の配列で組み立てるので、走査の各段階で領域を確保しない (配列の伸長を除く)。
+		 * @note	木を変更すると無効になる。
+		 */
+		class Iterator
+		{
+			friend class PatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID, ALLOCATOR, COUNTER>;
+
+		private:
+
+			typedef Node<KTYPE, LTYPE, VTYPE> N;
+			typedef Children<KTYPE, N> C;
+
+			/**
+			 * 走査中のノード
+			 */
+			struct Frame
+			{
+				const N* n;	///< ノード (0の時は根)
+				const C* c;	///< ノードの子ノード
+				uint32_t i;	///< 次に訪れる子ノードの走査位置
+				size_t d;	///< ノードに至るキーの長さ
+			};
+
+			std::vector<Frame> s_;	///< 根から走査中のノードまでの経路 (空の時は終端)
+			std::vector<KTYPE> k_;	///< 走査中のノードに至るキー
+
+			/**
+			 * ノードを経路に追加
+			 * @param[in]	n	ノード
+			 * @param[in]	k	ノードに至るキーの値
+			 */
+			void
+			push(const N* n,
+				 KTYPE k)
+				{
+					k_.resize(s_.back().d);
+					k_.push_back(k);
+					k_.insert(k_.end(), n->d_, n->d_ + n->l_);
+					Frame f = {n, &n->c_, 0, k_.size()};
+					s_.push_back(f);
+				}
+
+			/**
+			 * 先行順で次の末端ノードに移動
+			 * @note	移動先がない時は終端となる。
+			 */
+			void
+			next()
+				{
+					while (!s_.empty()) {
+						Frame& f = s_.back();
+						const uint32_t e = f.c->end();
+
+						while (f.i < e && !f.c->node_at(f.i)) ++f.i;
+						if (f.i == e) {
+							s_.pop_back();
+							continue;
+						}
+
+						const N* n = f.c->node_at(f.i);
+						const KTYPE k = f.c->key_at(f.i);
+						++f.i;
+						push(n, k);
+						if (n->v_ != INVALID) return;
+					}
+				}
+
+		public:
+
+			/**
+			 * コンストラクタ (終端)
+			 */
+			Iterator()
+				: s_(), k_()
+				{
+					;
+				}
+
+			/**
+			 * 走査中のキーを取得
+			 * @return	キー (要素数は @a length)
+			 */
+			const KTYPE*
+			key() const
+				{
+					assert(!s_.empty());
+
+					return k_.data();
+				}
+
+			/**
+			 * 走査中のキーの長さを取得
+			 * @return	キーの要素数
+			 */
+			LTYPE
+			length() const
+				{
+					assert(!s_.empty());
+
+					return (LTYPE)s_.back().d;
+				}
+
+			/**
+			 * 走査中のキーに対応する値を取得
+			 * @return	値
+			 */
+			VTYPE
+			value() const
+				{
+					assert(!s_.empty());
 
-						while (i < n) {
-							if (node->d_[i] != key[i]) break;
-							++i;
-						}
+					return s_.back().n->v_;
+				}
 
-						if (i < n) {
-							// 分離
-							Node<K_, L_, V_>* p = new Node<K_, L_, V_>(key, i, I_);
-							p->c_ = new std::unordered_map<K_, Node<K_, L_, V_>*>;
-							(*p->c_)[node->d_[i]] = node;
-							node->cut_head(i + 1);
-							(*p->c_)[key[i]] = new Node<K_, L_, V_>(key + (i + 1), length - (i + 1), value);
-							node = p;
-						}
-						else {
-							if (node->l_ < length) {
-								// 追加
-								Node<K_, L_, V_>* c(0);
-								if (node->c_) {
-									if (node->c_->find(key[i]) != node->c_->end()) c = (*node->c_)[key[i]];
-								}
-								else {
-									node->c_ = new std::unordered_map<K_, Node<K_, L_, V_>*>;
-								}
-								(*node->c_)[key[i]] = Node<K_, L_, V_>::Add(c, key + (i + 1), length - (i + 1), value);
-							}
-							else if (length < node->l_) {
-								// 追加
-								Node<K_, L_, V_>* p = new Node<K_, L_, V_>(key, length, value);
-								p->c_ = new std::unordered_map<K_, Node<K_, L_, V_>*>;
-								(*p->c_)[node->d_[i]] = node;
-								node->cut_head(i + 1);
-								node = p;
-							}
-							else {
-								// 更新
-								node->v_ = value;
-							}
-						}
-					}
-					else {
-						node = new Node<K_, L_, V_>(key, length, value);
-					}
+			/**
+			 * 次のキーに移動
+			 * @return	自身
+			 */
+			Iterator&
+			operator ++()
+				{
+					assert(!s_.empty());
 
-					return node;
+					next();
+					return *this;
 				}
-		};
 
-		std::unordered_map<KTYPE, Node<KTYPE, LTYPE, VTYPE>*> head_;	///< ノード群
+			/**
+			 * 走査位置が等しいか否か
+			 * @param[in]	other	比較対象
+			 * @return	true: 等しい, false: 等しくない
+			 */
+			bool
+			operator ==(const Iterator& other) const
+				{
+					if (s_.empty() || other.s_.empty()) return s_.empty() == other.s_.empty();
+					return s_.back().n == other.s_.back().n;
+				}
 
-	public:
+			/**
+			 * 走査位置が異なるか否か
+			 * @param[in]	other	比較対象
+			 * @return	true: 異なる, false: 等しい
+			 */
+			bool
+			operator !=(const Iterator& other) const
+				{
+					return !(*this == other);
+				}
+		};
 
 		/**
 		 * コンストラクタ
 		 */
-		PatriciaTrie() = default;
+		PatriciaTrie()
+			: allocator_(), head_()
+			{
+				;
+			}
 
 		/**
 		 * コピー・コンストラクタ (使用禁止)
 		 */
-		PatriciaTrie(const PatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID>&) = delete;
+		PatriciaTrie(const PatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID, ALLOCATOR, COUNTER>&) = delete;
 
 		/**
 		 * 代入演算子 (使用禁止)
 		 */
 		PatriciaTrie&
-		operator =(const PatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID>&) = delete;
+		operator =(const PatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID, ALLOCATOR, COUNTER>&) = delete;
 
 		/**
 		 * デストラクタ
+		 * @note	アロケータが一括解放できる時はノードを個別に解放しない。
 		 */
 		virtual
 		~PatriciaTrie()
 			{
-				for (auto n : head_) { delete n.second; }
+				if (ALLOCATOR::BulkRelease()) return;
+
+				for (uint32_t i(0), e = head_.end(); i < e; ++i) {
+					Node<KTYPE, LTYPE, VTYPE>* n = head_.node_at(i);
+					if (n) Node<KTYPE, LTYPE, VTYPE>::Destroy(allocator_, n);
+				}
+				head_.release(allocator_);
 			}
 
 		/**
@@ -322,9 +1649,89 @@ namespace ys
 				assert(0 < length);
 				assert(value != INVALID);
 
-				Node<KTYPE, LTYPE, VTYPE>* node(0);
-				if (head_.find(key[0]) != head_.end()) node = head_[key[0]];
-				head_[key[0]] = Node<KTYPE, LTYPE, VTYPE>::Add(node, key + 1, length - 1, value);
+				Node<KTYPE, LTYPE, VTYPE>** node = head_.slot(key[0]);
+				if (node) {
+					*node = Node<KTYPE, LTYPE, VTYPE>::Add(allocator_, *node, key + 1, length - 1, value);
+				}
+				else {
+					head_.insert(allocator_, key[0], Node<KTYPE, LTYPE, VTYPE>::Create(allocator_, key + 1, length - 1, value));
+				}
+			}
+
+		/**
+		 * 整列済みのキー群から木を構築
+		 * @param[in]	begin	キー群の先頭
+		 * @param[in]	end	キー群の終端
+		 * @note	要素はメンバ @a first にキー (メンバ関数 data(), size() を持つ型)、
+		 *			メンバ @a second にキーに対応する値を持つこと (例: std::pair<std::string, VTYPE>)。
+		 * @note	キー群は各要素を符号なし整数とみなした辞書順 (std::string の既定の順序) に整列済みであること。
+		 *			同じキーが複数ある時は最後の値を採用する。
+		 * @note	木が空の時はノードの分離を伴わずにキー群を1度ずつ走査して構築し、
+		 *			空でない時は @a add_key を繰り返す。
+		 */
+		template<typename ITERATOR>
+		void
+		build_from_sorted(ITERATOR begin,
+						  ITERATOR end)
+			{
+				if (0 < head_.size()) {
+					for (; begin != end; ++begin) {
+						add_key(begin->first.data(), (LTYPE)begin->first.size(), begin->second);
+					}
+					return;
+				}
+
+				std::vector<Work<ITERATOR> > g;
+				Group(begin, end, 0, g);
+				head_.reserve(allocator_, g.size());
+				for (const auto& w : g) head_.insert(allocator_, w.k, Build(allocator_, w.b, w.l, w.e, 1));
+			}
+
+		/**
+		 * 整列済みのキー群から木を並列に構築
+		 * @param[in]	begin	キー群の先頭
+		 * @param[in]	end	キー群の終端
+		 * @param[in]	threads	スレッドの数 (0の時はハードウェアの並列数)
+		 * @note	キー群の要件は @a build_from_sorted と同じ。
+		 * @note	キー群を先頭の値で分割し、各部分木をスレッド毎のアロケータで構築してから @a head_ に連結する。
+		 *			スレッド毎のアロケータが確保した領域は、最後に木のアロケータへ移管する (@a ALLOCATOR::splice)。
+		 * @note	木が空でない時は @a build_from_sorted と同じ。
+		 */
+		template<typename ITERATOR>
+		void
+		build_parallel(ITERATOR begin,
+					   ITERATOR end,
+					   unsigned int threads = 0)
+			{
+				typedef Node<KTYPE, LTYPE, VTYPE> N;
+
+				if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+				if (0 < head_.size() || threads == 1) {
+					build_from_sorted(begin, end);
+					return;
+				}
+
+				std::vector<Work<ITERATOR> > g;
+				Group(begin, end, 0, g);
+				threads = (unsigned int)std::min((size_t)threads, g.size());
+
+				std::vector<N*> nodes(g.size(), (N*)0);
+				std::vector<ALLOCATOR> allocators(threads);
+				std::vector<std::thread> workers;
+				std::atomic<size_t> next(0);	// 次に構築する部分木
+
+				for (unsigned int i(0); i < threads; ++i) {
+					workers.push_back(std::thread([&, i]() {
+								for (size_t j; (j = next.fetch_add(1)) < g.size(); ) {
+									nodes[j] = Build(allocators[i], g[j].b, g[j].l, g[j].e, 1);
+								}
+							}));
+				}
+				for (auto& w : workers) w.join();
+
+				head_.reserve(allocator_, g.size());
+				for (size_t j(0); j < g.size(); ++j) head_.insert(allocator_, g[j].k, nodes[j]);
+				for (auto& a : allocators) allocator_.splice(a);
 			}
 
 		/**
@@ -333,6 +1740,7 @@ namespace ys
 		 * @param[in]	length	配列 @a key の要素数
 		 * @return	キー @a key に対応する値
 		 * @note	キーが見つからなかった場合は @a INVALID が返却される。
+		 * @note	不要になったノードは解放し、キーの全体を親ノードと統合する。
 		 */
 		VTYPE
 		remove_key(const KTYPE* key,
@@ -341,9 +1749,15 @@ namespace ys
 				assert(key);
 				assert(0 < length);
 
-				auto it = head_.find(key[0]);
-				if (it == head_.end()) return INVALID;
-				return it->second->remove_key(key + 1, length - 1);
+				Node<KTYPE, LTYPE, VTYPE>** node = head_.slot(key[0]);
+				if (!node) return INVALID;
+
+				VTYPE r;
+				Node<KTYPE, LTYPE, VTYPE>* n = Node<KTYPE, LTYPE, VTYPE>::Remove(allocator_, *node, key + 1, length - 1, r);
+				if (n) *node = n;
+				else head_.erase(allocator_, key[0]);
+
+				return r;
 			}
 
 		/**
@@ -360,9 +1774,10 @@ namespace ys
 				assert(key);
 				assert(0 < length);
 
-				auto it = head_.find(key[0]);
-				if (it == head_.end()) return INVALID;
-				return it->second->get_value(key + 1, length - 1);
+				COUNTER::Count(COUNT_OPERATION);
+				const Node<KTYPE, LTYPE, VTYPE>* node = head_.find(key[0]);
+				if (!node) return INVALID;
+				return node->get_value(key + 1, length - 1);
 			}
 
 		/**
@@ -370,18 +1785,507 @@ namespace ys
 		 * @param[in]	buffer	探索対象のデータ
 		 * @param[in]	length	配列 @a buffer の要素数
 		 * @param[out]	values	配列 @a buffer の接頭辞となるキーの全ての値
+		 * @note	テンプレートのパラメータ @a CODE には区切りの方針 (@a Elements, @a Utf8 等) を与え、区切りで終わるキーのみを対象とする。
 		 */
+		template<typename CODE = Elements<KTYPE> >
 		void
 		get_values(const KTYPE* buffer,
 				   LTYPE length,
 				   std::vector<VTYPE>& values) const
+			{
+				get_values<CODE>(buffer, length, [&values](VTYPE v, LTYPE) { values.push_back(v); return true; });
+			}
+
+		/**
+		 * キーを探索 (共通接頭辞探索, 接頭辞となるキーの値を固定長の配列に獲得)
+		 * @param[in]	buffer	探索対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[out]	values	配列 @a buffer の接頭辞となるキーの値 (短い順)
+		 * @param[in]	capacity	配列 @a values の要素数
+		 * @param[out]	lengths	各キーの長さ (0を許す, 要素数 @a capacity)
+		 * @return	格納した値の数
+		 * @note	配列 @a values が埋まった時点で探索を終了する。
+		 * @note	テンプレートのパラメータ @a CODE には区切りの方針 (@a Elements, @a Utf8 等) を与え、区切りで終わるキーのみを対象とする。
+		 */
+		template<typename CODE = Elements<KTYPE> >
+		size_t
+		get_values(const KTYPE* buffer,
+				   LTYPE length,
+				   VTYPE* values,
+				   size_t capacity,
+				   LTYPE* lengths = 0) const
+			{
+				assert(values || capacity == 0);
+
+				size_t n(0);
+				if (capacity == 0) return n;
+
+				get_values<CODE>(buffer, length, [&](VTYPE v, LTYPE l) {
+						if (lengths) lengths[n] = l;
+						values[n] = v;
+						return ++n < capacity;
+					});
+
+				return n;
+			}
+
+		/**
+		 * キーを探索 (共通接頭辞探索, 接頭辞となるキーを順に訪問)
+		 * @param[in]	buffer	探索対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[in]	visitor	接頭辞となるキーが見つかる度に短い順に呼び出す関数 (引数は値・キーの長さ, false を返すと探索を中止)
+		 * @note	領域を確保しない。
+		 * @note	テンプレートのパラメータ @a CODE には区切りの方針 (@a Elements, @a Utf8 等) を与え、区切りで終わるキーのみを対象とする。
+		 */
+		template<typename CODE = Elements<KTYPE>, typename VISITOR>
+		void
+		get_values(const KTYPE* buffer,
+				   LTYPE length,
+				   VISITOR visitor) const
 			{
 				assert(buffer);
 				assert(0 < length);
 
-				auto it = head_.find(buffer[0]);
-				if (it == head_.end()) return;
-				it->second->get_values(buffer + 1, length - 1, values);
+				COUNTER::Count(COUNT_OPERATION);
+				const Node<KTYPE, LTYPE, VTYPE>* node = head_.find(buffer[0]);
+				if (!node) return;
+
+				auto f = [&](VTYPE v, LTYPE l) { return !CODE::Boundary(buffer, (size_t)length, (size_t)l) || visitor(v, l); };
+				node->get_values(buffer + 1, length - 1, f, (LTYPE)1);
+			}
+
+		/**
+		 * キーを探索 (最長一致, 接頭辞となる最長のキーの値を獲得)
+		 * @param[in]	buffer	探索対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[out]	matched	一致したキーの長さ (0を許す, 見つからなかった時は変更しない)
+		 * @return	配列 @a buffer の接頭辞となる最長のキーの値
+		 * @note	キーが見つからなかった場合は @a INVALID が返却される。
+		 * @note	領域を確保せず、辿ったキー末端のうち最も深いもののみを保持する。
+		 * @note	テンプレートのパラメータ @a CODE には区切りの方針 (@a Elements, @a Utf8 等) を与え、区切りで終わるキーのみを対象とする。
+		 */
+		template<typename CODE = Elements<KTYPE> >
+		VTYPE
+		get_longest_prefix(const KTYPE* buffer,
+						   LTYPE length,
+						   LTYPE* matched = 0) const
+			{
+				VTYPE r(INVALID);
+				LTYPE n(0);
+
+				get_values<CODE>(buffer, length, [&](VTYPE v, LTYPE l) {
+						r = v;
+						n = l;
+						return true;
+					});
+
+				if (matched && r != INVALID) *matched = n;
+				return r;
+			}
+
+		/**
+		 * データを走査 (データ中に現れるキーを全て報告)
+		 * @param[in]	buffer	走査対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[in]	callback	キーが現れる度に呼び出す関数 (引数は位置・キーの長さ・値, false を返すと走査を中止)
+		 * @param[in]	mode	走査の方式
+		 * @return	報告したキーの数
+		 * @note	各位置から根に戻って共通接頭辞探索を行うため (1回の走査ではない)、
+		 *			所要時間はデータの長さと照合するキーの深さの積に比例する。結果を格納する領域は確保しない。
+		 * @note	データの長さに比例する時間で全てのキーを列挙するには @a AhoCorasick を用いる
+		 *			(報告はキーの終わる位置の順となる)。
+		 * @note	@a SCAN_LONGEST の時は、キーが見つからなかった位置は次の区切りまで進める。
+		 * @note	テンプレートのパラメータ @a CODE には区切りの方針 (@a Elements, @a Utf8 等) を与え、
+		 *			区切りから始まり区切りで終わるキーのみを報告する (@a Utf8 の時は符号位置の途中から探索しない)。
+		 */
+		template<typename CODE = Elements<KTYPE>, typename CALLBACK>
+		size_t
+		scan(const KTYPE* buffer,
+			 size_t length,
+			 CALLBACK callback,
+			 ScanMode mode = SCAN_ALL) const
+			{
+				assert(buffer || length == 0);
+
+				typedef Node<KTYPE, LTYPE, VTYPE> N;
+
+				size_t r(0);
+				size_t i(0);
+
+				while (i < length) {
+					const N* node = head_.find(buffer[i]);
+					size_t j = i + 1;	// 照合済みの位置
+					size_t b(0);	// 最長のキーの長さ
+					VTYPE v(INVALID);	// 最長のキーの値
+
+					while (node) {
+						if (length - j < (size_t)node->l_) break;
+						if (Symbols<KTYPE>::Mismatch(node->d_, buffer + j, node->l_) != node->l_) break;
+						j += node->l_;
+						if (node->v_ != INVALID && CODE::Boundary(buffer, length, j)) {
+							if (mode == SCAN_ALL) {
+								++r;
+								if (!callback(i, (LTYPE)(j - i), node->v_)) return r;
+							}
+							else {
+								b = j - i;
+								v = node->v_;
+							}
+						}
+						if (j == length) break;
+						node = node->c_.find(buffer[j]);
+						++j;
+					}
+
+					if (v != INVALID) {
+						++r;
+						if (!callback(i, (LTYPE)b, v)) return r;
+						i += b;
+					}
+					else {
+						i = CODE::Next(buffer, length, i);
+					}
+				}
+
+				return r;
+			}
+
+		/**
+		 * キーを一括で探索 (各キーに対応する値を獲得)
+		 * @param[in]	keys	キー群
+		 * @param[in]	lengths	各キーの要素数
+		 * @param[in]	n	キーの数
+		 * @param[out]	values	各キーに対応する値 (要素数 @a n)
+		 * @note	キーが見つからなかった場合は @a INVALID が格納される。
+		 * @note	最大 @a __PATRICIA_TRIE_BATCH__ 個のキーの探索を1段ずつ交互に進め、
+		 *			次に参照するノード・キー・子ノードの表を先読みしてメモリの待ち時間を重ね合わせる。
+		 */
+		void
+		get_values_batch(const KTYPE* const* keys,
+						 const LTYPE* lengths,
+						 size_t n,
+						 VTYPE* values) const
+			{
+				assert(keys);
+				assert(lengths);
+				assert(values);
+
+				typedef Node<KTYPE, LTYPE, VTYPE> N;
+
+				/**
+				 * 探索中のキーの状態
+				 */
+				struct State
+				{
+					const N* node;	///< 次に照合するノード (0の時は空き)
+					const KTYPE* key;	///< キーの未照合の部分
+					LTYPE length;	///< 配列 @a key の要素数
+					size_t index;	///< キーの番号
+					bool ready;	///< ノードの内容を先読み済みか否か
+				};
+
+				State s[__PATRICIA_TRIE_BATCH__];
+				size_t m(0);	// 探索を開始したキーの数
+				size_t k(0);	// 探索中のキーの数
+
+				for (size_t i(0); i < __PATRICIA_TRIE_BATCH__; ++i) s[i].node = 0;
+
+				do {
+					k = 0;
+					for (size_t i(0); i < __PATRICIA_TRIE_BATCH__; ++i) {
+						State& t = s[i];
+
+						// 空きに新たなキーを割り当て
+						bool fresh(false);
+						while (!t.node && m < n) {
+							assert(keys[m]);
+							assert(0 < lengths[m]);
+
+							COUNTER::Count(COUNT_OPERATION);
+							t.node = head_.find(keys[m][0]);
+							t.key = keys[m] + 1;
+							t.length = lengths[m] - 1;
+							t.index = m++;
+							t.ready = false;
+
+							if (t.node) {
+								__PATRICIA_TRIE_PREFETCH__(t.node);
+								fresh = true;
+							}
+							else {
+								values[t.index] = INVALID;
+							}
+						}
+						if (!t.node) continue;
+						++k;
+
+						// 先読みしたノードの参照は次の周回まで待つ
+						if (fresh) continue;
+
+						if (!t.ready) {
+							// ノードに到着したので、キーと子ノードの表を先読み
+							__PATRICIA_TRIE_PREFETCH__(t.node->d_);
+							t.node->c_.prefetch();
+							t.ready = true;
+							continue;
+						}
+
+						const N* node = t.node;
+						COUNTER::Count(COUNT_EDGE);
+						COUNTER::Count(COUNT_LABEL, t.length < node->l_ ? 0 : sizeof(KTYPE) * node->l_);
+						if (t.length < node->l_ ||
+							Symbols<KTYPE>::Mismatch(node->d_, t.key, node->l_) != node->l_) {
+							values[t.index] = INVALID;
+							t.node = 0;
+							continue;
+						}
+						if (t.length == node->l_) {
+							values[t.index] = node->v_;
+							t.node = 0;
+							continue;
+						}
+
+						t.node = node->c_.find(t.key[node->l_]);
+						if (!t.node) {
+							values[t.index] = INVALID;
+							continue;
+						}
+						t.key += node->l_ + 1;
+						t.length -= node->l_ + 1;
+						t.ready = false;
+						__PATRICIA_TRIE_PREFETCH__(t.node);
+					}
+				} while (0 < k || m < n);
+			}
+
+		/**
+		 * 編集距離が一定以下のキーを探索 (曖昧探索)
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @param[in]	distance	編集距離 (レーベンシュタイン距離) の上限
+		 * @param[in]	visitor	キーが見つかる度に昇順に呼び出す関数 (引数はキー・キーの長さ・値・編集距離, false を返すと探索を中止)
+		 * @return	見つかったキーの数
+		 * @note	ノードを深さ優先で1度ずつ辿りながら、キーの各要素までの編集距離の表を1行ずつ更新する。
+		 *			共通接頭辞の表は共有し、表の最小値が上限を超えた子孫は辿らない。
+		 */
+		template<typename VISITOR>
+		size_t
+		fuzzy_search(const KTYPE* key,
+					 LTYPE length,
+					 LTYPE distance,
+					 VISITOR visitor) const
+			{
+				typedef Node<KTYPE, LTYPE, VTYPE> N;
+
+				assert(key || length == 0);
+
+				/**
+				 * 走査中のノード
+				 */
+				struct Frame
+				{
+					const Children<KTYPE, N>* c;	///< ノードの子ノード
+					uint32_t i;	///< 次に訪れる子ノードの走査位置
+					size_t d;	///< ノードに至るキーの長さ
+				};
+
+				const size_t w = (size_t)length + 1;	// 表の1行の要素数
+				std::vector<LTYPE> t(w);	// 深さ毎の編集距離の表 (深さ d の行は t[d * w] から)
+				std::vector<KTYPE> k;	// 走査中のノードに至るキー
+				std::vector<Frame> s;
+				size_t r(0);
+
+				for (size_t j(0); j < w; ++j) t[j] = (LTYPE)j;
+				Frame f = {&head_, 0, 0};
+				s.push_back(f);
+
+				while (!s.empty()) {
+					Frame& p = s.back();
+					const uint32_t e = p.c->end();
+
+					while (p.i < e && !p.c->node_at(p.i)) ++p.i;
+					if (p.i == e) {
+						s.pop_back();
+						continue;
+					}
+
+					const N* node = p.c->node_at(p.i);
+					const size_t d = p.d;
+					k.resize(d);
+					k.push_back(p.c->key_at(p.i));
+					k.insert(k.end(), node->d_, node->d_ + node->l_);
+					++p.i;
+
+					// 枝の要素毎に表の行を追加 (上限を超える値は上限+1とし、対角線から上限以内の範囲のみを計算)
+					if (t.size() < (k.size() + 1) * w) t.resize((k.size() + 1) * w);
+					bool pruned(false);
+					size_t band(0);	// 最後の行の計算範囲の末尾
+					for (size_t x = d; x < k.size(); ++x) {
+						const LTYPE* a = t.data() + x * w;
+						LTYPE* b = t.data() + (x + 1) * w;
+						const size_t lo = x + 1 <= (size_t)distance ? 1 : x + 1 - distance;
+						const size_t hi = std::min((size_t)length, x + 1 + distance);
+						if ((size_t)length + 1 < lo) {
+							pruned = true;
+							break;
+						}
+
+						LTYPE m = b[lo - 1] = lo == 1 ? (LTYPE)std::min(x + 1, (size_t)distance + 1) : (LTYPE)(distance + 1);
+						for (size_t j = lo; j <= hi; ++j) {
+							LTYPE c = a[j - 1] + (key[j - 1] == k[x] ? 0 : 1);
+							c = std::min(c, (LTYPE)(a[j] + 1));
+							c = std::min(c, (LTYPE)(b[j - 1] + 1));
+							b[j] = c = std::min(c, (LTYPE)(distance + 1));
+							m = std::min(m, c);
+						}
+						if (hi < (size_t)length) b[hi + 1] = (LTYPE)(distance + 1);
+						band = hi;
+
+						if (distance < m) {
+							pruned = true;
+							break;
+						}
+					}
+					if (pruned) continue;
+
+					const LTYPE z = band < (size_t)length ? (LTYPE)(distance + 1) : t[k.size() * w + length];
+					if (node->v_ != INVALID && z <= distance) {
+						++r;
+						if (!visitor(k.data(), (LTYPE)k.size(), node->v_, z)) return r;
+					}
+
+					Frame g = {&node->c_, 0, k.size()};
+					s.push_back(g);
+				}
+
+				return r;
+			}
+
+		/**
+		 * 最小のキーを指す反復子を取得
+		 * @return	反復子 (キーがない時は終端)
+		 */
+		Iterator
+		begin() const
+			{
+				Iterator r;
+				typename Iterator::Frame f = {0, &head_, 0, 0};
+				r.s_.push_back(f);
+				r.next();
+				return r;
+			}
+
+		/**
+		 * 終端を指す反復子を取得
+		 * @return	反復子
+		 */
+		Iterator
+		end() const
+			{
+				return Iterator();
+			}
+
+		/**
+		 * 接頭辞を持つキーの範囲を取得 (予測探索)
+		 * @param[in]	prefix	接頭辞
+		 * @param[in]	length	配列 @a prefix の要素数
+		 * @return	接頭辞 @a prefix を持つ最小のキーを指す反復子と終端の組 (昇順に走査できる)
+		 */
+		std::pair<Iterator, Iterator>
+		prefix_range(const KTYPE* prefix,
+					 LTYPE length) const
+			{
+				assert(prefix || length == 0);
+
+				if (length == 0) return std::make_pair(begin(), end());
+
+				const Node<KTYPE, LTYPE, VTYPE>* node = head_.find(prefix[0]);
+				LTYPE i(1);
+				Iterator r;
+				r.k_.push_back(prefix[0]);
+
+				while (node) {
+					const LTYPE n = std::min(node->l_, (LTYPE)(length - i));
+					if (Symbols<KTYPE>::Mismatch(node->d_, prefix + i, n) != n) break;
+					r.k_.insert(r.k_.end(), node->d_, node->d_ + node->l_);
+
+					if (length - i <= node->l_) {
+						// 接頭辞を消費したノードの子孫のみを走査
+						typename Iterator::Frame f = {node, &node->c_, 0, r.k_.size()};
+						r.s_.push_back(f);
+						if (node->v_ == INVALID) r.next();
+						return std::make_pair(r, end());
+					}
+
+					i += node->l_;
+					r.k_.push_back(prefix[i]);
+					node = node->c_.find(prefix[i]);
+					++i;
+				}
+
+				return std::make_pair(end(), end());
+			}
+
+		/**
+		 * キー以上の最小のキーを指す反復子を取得
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	反復子 (該当するキーがない時は終端)
+		 */
+		Iterator
+		lower_bound(const KTYPE* key,
+					LTYPE length) const
+			{
+				typedef typename std::make_unsigned<KTYPE>::type U;
+
+				assert(key || length == 0);
+
+				if (length == 0) return begin();
+
+				Iterator r;
+				typename Iterator::Frame f = {0, &head_, 0, 0};
+				r.s_.push_back(f);
+				LTYPE i(0);
+
+				for (;;) {
+					typename Iterator::Frame& t = r.s_.back();
+
+					if (i == length) {
+						// キーの全体が一致 (非末端の時は子孫の最小のキー)
+						if (t.n->v_ == INVALID) r.next();
+						return r;
+					}
+
+					const uint32_t e = t.c->end();
+					t.i = t.c->position(key[i]);
+					while (t.i < e && !t.c->node_at(t.i)) ++t.i;
+					if (t.i == e || t.c->key_at(t.i) != key[i]) {
+						// 走査位置以降の子ノードの子孫は全てキーより大きい
+						r.next();
+						return r;
+					}
+
+					const Node<KTYPE, LTYPE, VTYPE>* node = t.c->node_at(t.i);
+					const LTYPE n = std::min(node->l_, (LTYPE)(length - (i + 1)));
+					const LTYPE m = Symbols<KTYPE>::Mismatch(node->d_, key + (i + 1), n);
+
+					if (m < n) {
+						// 子ノードの子孫は全てキーより大きい、または全て小さい
+						if ((U)node->d_[m] < (U)key[i + 1 + m]) ++t.i;
+						r.next();
+						return r;
+					}
+
+					if (m < node->l_) {
+						// キーが子ノードの途中で終わるので、子ノードの子孫は全てキーより大きい
+						r.next();
+						return r;
+					}
+
+					++t.i;
+					r.push(node, key[i]);
+					i += node->l_ + 1;
+				}
 			}
 
 		/**
@@ -408,7 +2312,120 @@ namespace ys
 		void
 		print(FILE* file = stdout) const
 			{
-				for (auto h : head_) h.second->print(file, h.first);
+				for (uint32_t i(0), e = head_.end(); i < e; ++i) {
+					const Node<KTYPE, LTYPE, VTYPE>* n = head_.node_at(i);
+					if (n) n->print(file, head_.key_at(i));
+				}
+			}
+
+		/**
+		 * 木の統計情報
+		 * @note	深さはノードの数で数え、@a head_ の子ノードを1とする (深さ0は @a head_ 自体)。
+		 * @note	子ノードの数の区分は 0, 1, 2, 3, 4, 5〜8, 9〜16, 17〜48, 49〜256, 257以上 の順。
+		 */
+		struct Stats
+		{
+			enum {
+				DEPTHS = 32,	///< 深さ毎に集計する深さの数 (それ以上は最後の深さに集計)
+				FANOUTS = 10	///< 子ノードの数の区分の数
+			};
+
+			size_t nodes;	///< ノードの数
+			size_t terminals;	///< キー末端のノードの数 (キーの数)
+			size_t node_bytes;	///< ノードのバイト数の合計
+			size_t label_bytes;	///< キーの全体の領域のバイト数の合計
+			size_t table_bytes;	///< 子ノードの表のバイト数の合計 (@a head_ を含む)
+			size_t heap_bytes;	///< 確保した領域のバイト数の合計 (アロケータの管理領域を除く推定値)
+			size_t max_depth;	///< ノードの深さの最大値
+			double avg_depth;	///< キー末端のノードの深さの平均値 (キーの探索で辿るノードの数)
+			size_t fanout[DEPTHS][FANOUTS];	///< 深さ・子ノードの数の区分毎のノードの数
+		};
+
+		/**
+		 * 統計情報を計算
+		 * @return	統計情報
+		 * @note	木を1度だけ走査し、走査の作業領域のみを用いる
+		 *			(兄弟を残した祖先が多い木を除き、領域を確保しない)。
+		 */
+		Stats
+		stats() const
+			{
+				typedef Node<KTYPE, LTYPE, VTYPE> N;
+				typedef Children<KTYPE, N> C;
+
+				/**
+				 * 走査中の子ノードの表
+				 */
+				struct Frame
+				{
+					const C* c;	///< 子ノードの表
+					uint32_t i;	///< 次に辿る子ノードの位置
+					uint32_t d;	///< 子ノードの深さ
+				};
+
+				enum {
+					FRAMES = 64	///< 領域を確保せずに保持する表の数
+				};
+
+				Stats r = Stats();
+				size_t depths(0);	// キー末端のノードの深さの合計
+
+				auto fanout = [](size_t n) -> size_t {
+					if (n <= 4) return n;
+					if (n <= 8) return 5;
+					if (n <= 16) return 6;
+					if (n <= 48) return 7;
+					return n <= 256 ? 8 : 9;
+				};
+
+				r.table_bytes = head_.bytes();
+				r.fanout[0][fanout(head_.size())] = 1;
+
+				// 兄弟を残した表のみを積み、最後の子ノードを辿る時は先に取り除く
+				Frame f[FRAMES];
+				std::vector<Frame> g;	// 溢れた表
+				size_t n(0);
+
+				if (0 < head_.size()) {
+					Frame h = {&head_, 0, 1};
+					f[n++] = h;
+				}
+
+				while (0 < n) {
+					Frame& t = g.empty() ? f[n - 1] : g.back();
+					const uint32_t e = t.c->end();
+					while (t.i < e && !t.c->node_at(t.i)) ++t.i;
+
+					const N* x = t.c->node_at(t.i++);
+					const uint32_t d = t.d;
+					while (t.i < e && !t.c->node_at(t.i)) ++t.i;
+					if (t.i == e) {
+						if (g.empty()) --n;
+						else g.pop_back();
+					}
+
+					++r.nodes;
+					if (x->v_ != INVALID) {
+						++r.terminals;
+						depths += d;
+					}
+					if (x->d_) r.label_bytes += sizeof(KTYPE) * (x->o_ + x->l_);
+					r.table_bytes += x->c_.bytes();
+					r.max_depth = std::max(r.max_depth, (size_t)d);
+					++r.fanout[std::min((size_t)d, (size_t)Stats::DEPTHS - 1)][fanout(x->c_.size())];
+
+					if (0 < x->c_.size()) {
+						Frame c = {&x->c_, 0, d + 1};
+						if (n < FRAMES) f[n++] = c;
+						else g.push_back(c);
+					}
+				}
+
+				r.node_bytes = sizeof(N) * r.nodes;
+				r.heap_bytes = r.node_bytes + r.label_bytes + r.table_bytes;
+				r.avg_depth = r.terminals ? (double)depths / (double)r.terminals : 0.0;
+
+				return r;
 			}
 
 		/**
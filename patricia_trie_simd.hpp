@@ -0,0 +1,301 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	patricia_trie_simd.hpp
+ * @brief	Comparison kernels of key sequences for patricia trie.
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ * @note	マクロ @a __PATRICIA_TRIE_NO_SIMD__ を定義すると SIMD 命令を使わない。
+ */
+
+#ifndef	__PATRICIA_TRIE_SIMD_HPP__
+#define	__PATRICIA_TRIE_SIMD_HPP__	"patricia_trie_simd.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if	!defined(__PATRICIA_TRIE_NO_SIMD__)
+#if	defined(__AVX2__)
+#include <immintrin.h>
+#define	__PATRICIA_TRIE_AVX2__
+#define	__PATRICIA_TRIE_SSE2__
+#elif	defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define	__PATRICIA_TRIE_SSE2__
+#elif	defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define	__PATRICIA_TRIE_NEON__
+#endif
+#endif
+
+namespace ys
+{
+	/**
+	 * キーの要素列の比較 (汎用)
+	 * @note	テンプレートのパラメータ @a B_ が true の時は1バイトの要素向けの特殊化を用いる。
+	 */
+	template<typename K_, bool B_ = (sizeof(K_) == 1)>
+	class Symbols
+	{
+	public:
+
+		/**
+		 * @a Find で線形探索する要素数の上限を取得
+		 * @return	要素数
+		 */
+		static uint32_t
+		Span()
+			{
+				return 16;
+			}
+
+		/**
+		 * 2つの要素列の先頭から一致する要素数を計算
+		 * @param[in]	a	要素列
+		 * @param[in]	b	要素列
+		 * @param[in]	n	比較する要素数の上限
+		 * @return	最初に一致しなかった位置 (全て一致した時は @a n)
+		 */
+		template<typename L_>
+		static L_
+		Mismatch(const K_* a,
+				 const K_* b,
+				 L_ n)
+			{
+				L_ i(0);
+
+				while (i < n) {
+					if (a[i] != b[i]) break;
+					++i;
+				}
+
+				return i;
+			}
+
+		/**
+		 * 要素列から値を線形探索
+		 * @param[in]	keys	要素列
+		 * @param[in]	n	配列 @a keys の要素数 (@a Span 以下)
+		 * @param[in]	k	探索する値
+		 * @return	値 @a k の位置 (見つからなかった時は @a n)
+		 */
+		static uint32_t
+		Find(const K_* keys,
+			 uint32_t n,
+			 K_ k)
+			{
+				for (uint32_t i(0); i < n; ++i) {
+					if (keys[i] == k) return i;
+				}
+
+				return n;
+			}
+	};
+
+	/**
+	 * キーの要素列の比較 (1バイトの要素)
+	 * @note	AVX2, SSE2, NEON のうちコンパイル時に利用可能な命令を用い、
+	 *			いずれも利用できない時は汎用の実装と同じ処理を行う。
+	 */
+	template<typename K_>
+	class Symbols<K_, true>
+	{
+	private:
+
+		/**
+		 * 最下位の1のビットの位置を取得
+		 * @param[in]	x	0以外の値
+		 * @return	ビットの位置
+		 */
+		static unsigned int
+		Ctz(uint64_t x)
+			{
+#if	defined(__GNUC__) || defined(__clang__)
+				return (unsigned int)__builtin_ctzll(x);
+#else
+				unsigned int i(0);
+				while (!(x & 1)) {
+					x >>= 1;
+					++i;
+				}
+				return i;
+#endif
+			}
+
+		/**
+		 * 8要素をまとめて読み出し
+		 * @param[in]	p	要素列
+		 * @return	読み出した値
+		 */
+		static uint64_t
+		Load64(const K_* p)
+			{
+				uint64_t x;
+				std::memcpy((void*)&x, (const void*)p, 8);
+				return x;
+			}
+
+		/**
+		 * 4要素をまとめて読み出し
+		 * @param[in]	p	要素列
+		 * @return	読み出した値
+		 */
+		static uint32_t
+		Load32(const K_* p)
+			{
+				uint32_t x;
+				std::memcpy((void*)&x, (const void*)p, 4);
+				return x;
+			}
+
+	public:
+
+		/**
+		 * @a Find で線形探索する要素数の上限を取得
+		 * @return	要素数
+		 */
+		static uint32_t
+		Span()
+			{
+#if	defined(__PATRICIA_TRIE_SSE2__) || defined(__PATRICIA_TRIE_NEON__)
+				return 48;
+#else
+				return 16;
+#endif
+			}
+
+		/**
+		 * 2つの要素列の先頭から一致する要素数を計算
+		 * @param[in]	a	要素列
+		 * @param[in]	b	要素列
+		 * @param[in]	n	比較する要素数の上限
+		 * @return	最初に一致しなかった位置 (全て一致した時は @a n)
+		 * @note	配列 @a a, @a b の範囲外は読まない。
+		 */
+		template<typename L_>
+		static L_
+		Mismatch(const K_* a,
+				 const K_* b,
+				 L_ n)
+			{
+				L_ i(0);
+
+#if	defined(__PATRICIA_TRIE_AVX2__)
+				for (; 64 <= n - i; i += 64) {
+					__m256i e0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + i)), _mm256_loadu_si256((const __m256i*)(b + i)));
+					__m256i e1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + i + 32)), _mm256_loadu_si256((const __m256i*)(b + i + 32)));
+					if (~(uint32_t)_mm256_movemask_epi8(_mm256_and_si256(e0, e1))) break;
+				}
+				for (; 32 <= n - i; i += 32) {
+					__m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+					__m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+					uint32_t m = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+					if (m) return i + (L_)Ctz(m);
+				}
+#endif
+#if	defined(__PATRICIA_TRIE_SSE2__)
+				for (; 64 <= n - i; i += 64) {
+					// 64要素ずつ一致を確かめ、不一致があれば16要素ずつの比較で位置を特定
+					__m128i e0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i)));
+					__m128i e1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i + 16)), _mm_loadu_si128((const __m128i*)(b + i + 16)));
+					__m128i e2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i + 32)), _mm_loadu_si128((const __m128i*)(b + i + 32)));
+					__m128i e3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i + 48)), _mm_loadu_si128((const __m128i*)(b + i + 48)));
+					if (_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(e0, e1), _mm_and_si128(e2, e3))) != 0xFFFF) break;
+				}
+				for (; 16 <= n - i; i += 16) {
+					__m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+					__m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+					uint32_t m = ~(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) & 0xFFFF;
+					if (m) return i + (L_)Ctz(m);
+				}
+#elif	defined(__PATRICIA_TRIE_NEON__)
+				for (; 16 <= n - i; i += 16) {
+					uint8x16_t e = vceqq_u8(vld1q_u8((const uint8_t*)(a + i)), vld1q_u8((const uint8_t*)(b + i)));
+					uint64_t l = ~vgetq_lane_u64(vreinterpretq_u64_u8(e), 0);
+					if (l) return i + (L_)(Ctz(l) / 8);
+					uint64_t h = ~vgetq_lane_u64(vreinterpretq_u64_u8(e), 1);
+					if (h) return i + 8 + (L_)(Ctz(h) / 8);
+				}
+#endif
+
+#if	defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+				// 残りは8要素ずつ比較し、端数は一致済みの要素と重なる位置から8要素・4要素をまとめて比較
+				for (; 8 <= n - i; i += 8) {
+					uint64_t x = Load64(a + i) ^ Load64(b + i);
+					if (x) return i + (L_)(Ctz(x) / 8);
+				}
+				if (i == n) return n;
+				if (8 <= n) {
+					uint64_t x = Load64(a + (n - 8)) ^ Load64(b + (n - 8));
+					return x ? n - 8 + (L_)(Ctz(x) / 8) : n;
+				}
+				if (4 <= n) {
+					uint32_t x = Load32(a) ^ Load32(b);
+					if (x) return (L_)(Ctz(x) / 8);
+					x = Load32(a + (n - 4)) ^ Load32(b + (n - 4));
+					return x ? n - 4 + (L_)(Ctz(x) / 8) : n;
+				}
+#endif
+
+				while (i < n) {
+					if (a[i] != b[i]) break;
+					++i;
+				}
+
+				return i;
+			}
+
+		/**
+		 * 要素列から値を線形探索
+		 * @param[in]	keys	要素列
+		 * @param[in]	n	配列 @a keys の要素数 (@a Span 以下)
+		 * @param[in]	k	探索する値
+		 * @return	値 @a k の位置 (見つからなかった時は @a n)
+		 * @note	SIMD 命令を用いる時は、配列 @a keys の先頭から @a n を16の倍数に切り上げた要素数を読む。
+		 *			範囲外の要素は結果に影響しないが、読み出し可能であること。
+		 * @note	要素数が少ない時は、分岐予測により子ノードの読み出しを先行できる逐次比較を用いる。
+		 */
+		static uint32_t
+		Find(const K_* keys,
+			 uint32_t n,
+			 K_ k)
+			{
+				if (n <= 8) {
+					for (uint32_t i(0); i < n; ++i) {
+						if (keys[i] == k) return i;
+					}
+					return n;
+				}
+
+#if	defined(__PATRICIA_TRIE_SSE2__)
+				const __m128i x = _mm_set1_epi8((char)k);
+				for (uint32_t i(0); i < n; i += 16) {
+					uint32_t m = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_loadu_si128((const __m128i*)(keys + i))));
+					if (m) {
+						i += Ctz(m);
+						return i < n ? i : n;
+					}
+				}
+				return n;
+#elif	defined(__PATRICIA_TRIE_NEON__)
+				const uint8x16_t x = vdupq_n_u8((uint8_t)k);
+				for (uint32_t i(0); i < n; i += 16) {
+					uint8x16_t e = vceqq_u8(x, vld1q_u8((const uint8_t*)(keys + i)));
+					uint64_t l = vgetq_lane_u64(vreinterpretq_u64_u8(e), 0);
+					uint64_t h = vgetq_lane_u64(vreinterpretq_u64_u8(e), 1);
+					if (l | h) {
+						i += l ? Ctz(l) / 8 : 8 + Ctz(h) / 8;
+						return i < n ? i : n;
+					}
+				}
+				return n;
+#else
+				for (uint32_t i(0); i < n; ++i) {
+					if (keys[i] == k) return i;
+				}
+				return n;
+#endif
+			}
+	};
+};
+
+#endif	// __PATRICIA_TRIE_SIMD_HPP__
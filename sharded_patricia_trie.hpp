@@ -0,0 +1,396 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	sharded_patricia_trie.hpp
+ * @brief	C++ template library of patricia trie sharded by key prefix with per-shard locking.
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ */
+
+#ifndef	__SHARDED_PATRICIA_TRIE_HPP__
+#define	__SHARDED_PATRICIA_TRIE_HPP__	"sharded_patricia_trie.hpp"
+
+#include <cstdio>
+#include <cstdint>
+#include <cassert>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <algorithm>
+#include <vector>
+#include "patricia_trie.hpp"
+
+namespace ys
+{
+	/**
+	 * 読み書きロック
+	 * @note	状態を1語の原子変数で表し、取得できるまで std::this_thread::yield で待つ。
+	 *			保持する時間の短い (木の1回の操作程度の) 排他に向く。
+	 * @note	書き込みを待つスレッドがある間は読み込みを新たに許さない (書き込み優先)。
+	 * @note	lock, unlock を持つので std::lock_guard と組み合わせられる。
+	 */
+	class ReadWriteLock
+	{
+	private:
+
+		enum : uint32_t {
+			WRITER = 0x80000000U,	///< 書き込み中
+			PENDING = 0x40000000U	///< 書き込み待ち
+		};
+
+		std::atomic<uint32_t> s_;	///< 状態 (下位のビットは読み込み中のスレッドの数)
+		char pad_[64 - sizeof(std::atomic<uint32_t>)];	///< 偽共有を避けるための詰め物
+
+	public:
+
+		/**
+		 * コンストラクタ
+		 */
+		ReadWriteLock()
+			: s_(0), pad_()
+			{
+				;
+			}
+
+		/**
+		 * コピー・コンストラクタ (使用禁止)
+		 */
+		ReadWriteLock(const ReadWriteLock&) = delete;
+
+		/**
+		 * 代入演算子 (使用禁止)
+		 */
+		ReadWriteLock&
+		operator =(const ReadWriteLock&) = delete;
+
+		/**
+		 * 書き込みのロックを取得
+		 */
+		void
+		lock()
+			{
+				for (;;) {
+					uint32_t s = s_.load(std::memory_order_relaxed);
+					if ((s & ~(uint32_t)PENDING) == 0) {
+						if (s_.compare_exchange_weak(s, WRITER, std::memory_order_acquire, std::memory_order_relaxed)) return;
+						continue;
+					}
+					if (!(s & PENDING)) s_.compare_exchange_weak(s, s | PENDING, std::memory_order_relaxed, std::memory_order_relaxed);
+					std::this_thread::yield();
+				}
+			}
+
+		/**
+		 * 書き込みのロックを解放
+		 */
+		void
+		unlock()
+			{
+				s_.fetch_and(~(uint32_t)WRITER, std::memory_order_release);
+			}
+
+		/**
+		 * 読み込みのロックを取得
+		 */
+		void
+		lock_shared()
+			{
+				for (;;) {
+					uint32_t s = s_.load(std::memory_order_relaxed);
+					if (!(s & (WRITER | PENDING))) {
+						if (s_.compare_exchange_weak(s, s + 1, std::memory_order_acquire, std::memory_order_relaxed)) return;
+						continue;
+					}
+					std::this_thread::yield();
+				}
+			}
+
+		/**
+		 * 読み込みのロックを解放
+		 */
+		void
+		unlock_shared()
+			{
+				s_.fetch_sub(1, std::memory_order_release);
+			}
+	};
+
+	/**
+	 * 分割したパトリシア木 (複数のスレッドから更新できる)
+	 * @note	キーの先頭の @a prefix 要素 (短いキーは全体) のハッシュ値で、独立した @a PatriciaTrie のいずれか (分割) に振り分ける。
+	 *			各分割は読み書きロックを持ち、異なる分割への追加・削除・探索は互いに待たない。
+	 * @note	@a prefix が1の時は @a PatriciaTrie::head_ の分割と同じく先頭の値のみで振り分けるので、
+	 *			共通接頭辞探索は1つの分割のみを参照する (一般には @a prefix 個以下)。
+	 *			UTF-8 のように先頭の値が偏るキーは、@a prefix を大きくすると分散する。
+	 * @note	キーの値の型によらず、分割は全て同じキーの値の型・アロケータの @a PatriciaTrie。
+	 * @note	複数の分割にまたがる探索は分割毎にロックを取るので、その間の更新との前後関係は分割毎に定まる。
+	 * @note	テンプレートのパラメータは @a PatriciaTrie と同じ。
+	 */
+	template<typename KTYPE, typename LTYPE, typename VTYPE, VTYPE INVALID = ~(VTYPE)0, typename ALLOCATOR = ArenaAllocator>
+	class ShardedPatriciaTrie
+	{
+	public:
+
+		typedef PatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID, ALLOCATOR> Trie;	///< 分割の型
+
+	private:
+
+		typedef typename std::make_unsigned<KTYPE>::type UTYPE;	///< キーのハッシュ値の計算に用いる型
+
+		/**
+		 * 分割
+		 */
+		struct Shard
+		{
+			mutable ReadWriteLock m;	///< 読み書きロック
+			Trie t;	///< 木
+			char pad[64];	///< 偽共有を避けるための詰め物
+
+			/**
+			 * コンストラクタ
+			 */
+			Shard()
+				: m(), t(), pad()
+				{
+					;
+				}
+		};
+
+		/**
+		 * 読み込みのロックの保持 (RAII)
+		 */
+		class Reader
+		{
+		private:
+
+			ReadWriteLock& m_;	///< 読み書きロック
+
+		public:
+
+			/**
+			 * コンストラクタ (ロックを取得)
+			 * @param[in,out]	m	読み書きロック
+			 */
+			explicit
+			Reader(ReadWriteLock& m)
+				: m_(m)
+				{
+					m_.lock_shared();
+				}
+
+			/**
+			 * コピー・コンストラクタ (使用禁止)
+			 */
+			Reader(const Reader&) = delete;
+
+			/**
+			 * 代入演算子 (使用禁止)
+			 */
+			Reader&
+			operator =(const Reader&) = delete;
+
+			/**
+			 * デストラクタ (ロックを解放)
+			 */
+			~Reader()
+				{
+					m_.unlock_shared();
+				}
+		};
+
+		Shard* shards_;	///< 分割群
+		size_t n_;	///< 分割の数
+		LTYPE p_;	///< 振り分けに用いるキーの先頭の要素数
+
+		/**
+		 * キーを振り分ける分割を取得
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数 (1以上)
+		 * @return	分割
+		 */
+		Shard&
+		shard(const KTYPE* key,
+			  LTYPE length) const
+			{
+				assert(key);
+				assert(0 < length);
+
+				if (n_ == 1) return shards_[0];
+
+				// FNV-1a (要素毎に下位のバイトから混ぜる)
+				uint64_t h(14695981039346656037ULL);
+				for (LTYPE i(0), e = std::min(length, p_); i < e; ++i) {
+					UTYPE k = (UTYPE)key[i];
+					for (size_t j(0); j < sizeof(UTYPE); ++j) {
+						h ^= (uint64_t)(k & 0xFF);
+						h *= 1099511628211ULL;
+						k = (UTYPE)(k >> 4 >> 4);
+					}
+				}
+
+				return shards_[(size_t)((h ^ (h >> 32)) % n_)];
+			}
+
+	public:
+
+		/**
+		 * コンストラクタ
+		 * @param[in]	shards	分割の数 (1以上)
+		 * @param[in]	prefix	振り分けに用いるキーの先頭の要素数 (1以上)
+		 */
+		explicit
+		ShardedPatriciaTrie(size_t shards = 16,
+							LTYPE prefix = 1)
+			: shards_(0), n_(shards), p_(prefix)
+			{
+				assert(0 < shards);
+				assert(0 < prefix);
+
+				shards_ = new Shard[n_];
+			}
+
+		/**
+		 * コピー・コンストラクタ (使用禁止)
+		 */
+		ShardedPatriciaTrie(const ShardedPatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID, ALLOCATOR>&) = delete;
+
+		/**
+		 * 代入演算子 (使用禁止)
+		 */
+		ShardedPatriciaTrie&
+		operator =(const ShardedPatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID, ALLOCATOR>&) = delete;
+
+		/**
+		 * デストラクタ
+		 * @note	操作中のスレッドがないこと。
+		 */
+		virtual
+		~ShardedPatriciaTrie()
+			{
+				delete [] shards_;
+			}
+
+		/**
+		 * キーを追加
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @param[in]	value	キー @a key に対応する値
+		 * @note	引数 @a value に @a INVALID を代入しないこと。
+		 * @note	同じ分割への追加・削除・探索とのみ排他する。
+		 */
+		void
+		add_key(const KTYPE* key,
+				LTYPE length,
+				VTYPE value = 0)
+			{
+				Shard& s = shard(key, length);
+				std::lock_guard<ReadWriteLock> lock(s.m);
+				s.t.add_key(key, length, value);
+			}
+
+		/**
+		 * キーを削除
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	キー @a key に対応する値
+		 * @note	キーが見つからなかった場合は @a INVALID が返却される。
+		 * @note	同じ分割への追加・削除・探索とのみ排他する。
+		 */
+		VTYPE
+		remove_key(const KTYPE* key,
+				   LTYPE length)
+			{
+				Shard& s = shard(key, length);
+				std::lock_guard<ReadWriteLock> lock(s.m);
+				return s.t.remove_key(key, length);
+			}
+
+		/**
+		 * キーを探索 (キーに対応する値を獲得)
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	キー @a key に対応する値
+		 * @note	キーが見つからなかった場合は @a INVALID が返却される。
+		 * @note	同じ分割の探索とは並行に行える。
+		 */
+		VTYPE
+		get_value(const KTYPE* key,
+				  LTYPE length) const
+			{
+				Shard& s = shard(key, length);
+				Reader lock(s.m);
+				return s.t.get_value(key, length);
+			}
+
+		/**
+		 * キーを探索 (共通接頭辞探索, 接頭辞となるキーの値を全て獲得)
+		 * @param[in]	buffer	探索対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[out]	values	配列 @a buffer の接頭辞となるキーの全ての値 (短い順)
+		 * @note	@a prefix 要素より短い接頭辞は長さ毎の分割を、それ以外は1つの分割のみを参照する。
+		 */
+		void
+		get_values(const KTYPE* buffer,
+				   LTYPE length,
+				   std::vector<VTYPE>& values) const
+			{
+				assert(buffer);
+				assert(0 < length);
+
+				LTYPE i(1);
+				for (; i < p_ && i < length; ++i) {
+					Shard& s = shard(buffer, i);
+					Reader lock(s.m);
+					VTYPE v = s.t.get_value(buffer, i);
+					if (v != INVALID) values.push_back(v);
+				}
+
+				Shard& s = shard(buffer, length);
+				Reader lock(s.m);
+				if (i == 1) {
+					s.t.get_values(buffer, length, values);
+					return;
+				}
+
+				// 長さ @a i 未満のキーは同じ分割にあっても報告済み
+				s.t.get_values(buffer, length, [&](VTYPE v, LTYPE l) {
+						if (i <= l) values.push_back(v);
+						return true;
+					});
+			}
+
+		/**
+		 * キーを探索 (キーの有無をチェック)
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	true: キーが見つかった, false: 見つからなかった
+		 */
+		bool
+		find_key(const KTYPE* key,
+				 LTYPE length) const
+			{
+				return get_value(key, length) != INVALID;
+			}
+
+		/**
+		 * 分割の数を取得
+		 * @return	分割の数
+		 */
+		size_t
+		shard_count() const
+			{
+				return n_;
+			}
+
+		/**
+		 * 値 @a INVALID を取得
+		 * @return	値 @a INVALID
+		 */
+		static VTYPE
+		InvalidValue()
+			{
+				return INVALID;
+			}
+	};
+};
+
+#endif	// __SHARDED_PATRICIA_TRIE_HPP__
@@ -0,0 +1,378 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	snapshot_patricia_trie.hpp
+ * @brief	C++ template library of patricia trie rebuilt in background and published as snapshots.
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ */
+
+#ifndef	__SNAPSHOT_PATRICIA_TRIE_HPP__
+#define	__SNAPSHOT_PATRICIA_TRIE_HPP__	"snapshot_patricia_trie.hpp"
+
+#include <cstdio>
+#include <cstdint>
+#include <cassert>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <algorithm>
+#include <vector>
+#include <utility>
+#include "patricia_trie.hpp"
+
+namespace ys
+{
+	/**
+	 * 再構築した木をスナップショットとして公開するパトリシア木
+	 * @note	探索は公開中の木 (スナップショット) の参照を原子的に取得してから行い、再構築を待たない。
+	 *			再構築は別の木を一括構築 (@a PatriciaTrie::build_parallel) し、参照を原子的に置き換えて公開する。
+	 * @note	置き換えた古い木は解放待ちとし、探索中のスレッドが参照を手放した後に再構築側のスレッドで解放する (@a reclaim)。
+	 *			探索側のスレッドで木を解放することはない (@a snapshot で取得した参照を保持し続けた場合を除く)。
+	 * @note	探索は複数のスレッドから行えるが、再構築 (@a rebuild, @a rebuild_async, @a wait, @a reclaim) は1つのスレッドから呼び出すこと。
+	 * @note	テンプレートのパラメータは @a PatriciaTrie と同じ。
+	 */
+	template<typename KTYPE, typename LTYPE, typename VTYPE, VTYPE INVALID = ~(VTYPE)0, typename ALLOCATOR = ArenaAllocator>
+	class SnapshotPatriciaTrie
+	{
+	public:
+
+		typedef PatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID, ALLOCATOR> Trie;	///< 公開する木の型
+		typedef std::shared_ptr<const Trie> Snapshot;	///< スナップショット (公開中の木の参照)
+		typedef std::pair<std::vector<KTYPE>, VTYPE> Entry;	///< 再構築に用いるキーと値
+
+		/**
+		 * 再構築の計測値
+		 * @note	時間の単位はナノ秒。
+		 */
+		struct Metrics
+		{
+			uint64_t builds;	///< 公開した回数
+			uint64_t failures;	///< 失敗した回数 (読み込み関数が false を返すか例外を投げた)
+			uint64_t last_build;	///< 直前の再構築の時間 (読み込み・整列・構築)
+			uint64_t max_build;	///< 再構築の時間の最大値
+			uint64_t total_build;	///< 再構築の時間の合計
+			uint64_t last_swap;	///< 直前の公開の時間 (参照の置き換え)
+			uint64_t max_swap;	///< 公開の時間の最大値
+			size_t keys;	///< 公開中の木の構築に用いたキー群の要素数
+			size_t retired;	///< 解放待ちの木の数
+		};
+
+	private:
+
+		typedef std::chrono::steady_clock Clock;	///< 計測に用いる時計
+
+		Snapshot t_;	///< 公開中の木 (std::atomic_load, std::atomic_store でのみ参照)
+		std::vector<Snapshot> r_;	///< 解放待ちの木
+		std::thread w_;	///< 再構築のスレッド
+		std::atomic<bool> busy_;	///< 再構築中か否か
+		mutable std::mutex m_;	///< 計測値・解放待ちの木の排他
+		Metrics s_;	///< 計測値
+		unsigned int p_;	///< 構築に用いるスレッドの数
+
+		/**
+		 * 経過時間を取得
+		 * @param[in]	s	開始時刻
+		 * @return	ナノ秒
+		 */
+		static uint64_t
+		Elapsed(Clock::time_point s)
+			{
+				return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - s).count();
+			}
+
+		/**
+		 * 要素を符号なし整数とみなした辞書順でキーを比較
+		 * @param[in]	a	キーと値
+		 * @param[in]	b	キーと値
+		 * @return	true: @a a のキーが @a b のキーより前, false: それ以外
+		 */
+		static bool
+		Less(const Entry& a,
+			 const Entry& b)
+			{
+				typedef typename std::make_unsigned<KTYPE>::type UTYPE;
+
+				return std::lexicographical_compare(a.first.begin(), a.first.end(), b.first.begin(), b.first.end(),
+													[](KTYPE x, KTYPE y) { return (UTYPE)x < (UTYPE)y; });
+			}
+
+		/**
+		 * 構築した木を公開
+		 * @param[in]	trie	構築した木
+		 * @param[in]	build	再構築の時間
+		 * @param[in]	keys	構築に用いたキー群の要素数
+		 */
+		void
+		publish(Trie* trie,
+				uint64_t build,
+				size_t keys)
+			{
+				Snapshot n(trie);
+				const Clock::time_point s = Clock::now();
+				Snapshot o = std::atomic_exchange(&t_, n);
+				const uint64_t swap = Elapsed(s);
+
+				std::lock_guard<std::mutex> lock(m_);
+				r_.push_back(o);
+				o.reset();
+				++s_.builds;
+				s_.last_build = build;
+				s_.max_build = std::max(s_.max_build, build);
+				s_.total_build += build;
+				s_.last_swap = swap;
+				s_.max_swap = std::max(s_.max_swap, swap);
+				s_.keys = keys;
+				reclaim_locked();
+			}
+
+		/**
+		 * 参照を手放された解放待ちの木を解放
+		 * @return	解放待ちの木の数
+		 * @note	@a m_ を取得済みであること。
+		 * @note	公開中でない木の参照は新たに取得されないので、参照の数が1 (自身のみ) なら解放できる。
+		 */
+		size_t
+		reclaim_locked()
+			{
+				auto it = std::remove_if(r_.begin(), r_.end(), [](const Snapshot& t) { return t.use_count() <= 1; });
+				r_.erase(it, r_.end());
+				s_.retired = r_.size();
+				return s_.retired;
+			}
+
+		/**
+		 * 計測値の失敗を記録
+		 */
+		void
+		fail()
+			{
+				std::lock_guard<std::mutex> lock(m_);
+				++s_.failures;
+			}
+
+	public:
+
+		/**
+		 * コンストラクタ
+		 * @param[in]	threads	構築に用いるスレッドの数 (0の時はハードウェアの並列数)
+		 * @note	公開中の木は空の木となる。
+		 */
+		explicit
+		SnapshotPatriciaTrie(unsigned int threads = 1)
+			: t_(new Trie()), r_(), w_(), busy_(false), m_(), s_(), p_(threads)
+			{
+				;
+			}
+
+		/**
+		 * コピー・コンストラクタ (使用禁止)
+		 */
+		SnapshotPatriciaTrie(const SnapshotPatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID, ALLOCATOR>&) = delete;
+
+		/**
+		 * 代入演算子 (使用禁止)
+		 */
+		SnapshotPatriciaTrie&
+		operator =(const SnapshotPatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID, ALLOCATOR>&) = delete;
+
+		/**
+		 * デストラクタ
+		 * @note	再構築中の時は終了を待つ。
+		 */
+		virtual
+		~SnapshotPatriciaTrie()
+			{
+				wait();
+			}
+
+		/**
+		 * スナップショットを取得
+		 * @return	公開中の木の参照
+		 * @note	参照を保持する間は木が解放されないので、複数の探索を同じ版の木に対して行える。
+		 *			保持し続けると解放待ちの木が残るので、探索を終えたら手放すこと。
+		 */
+		Snapshot
+		snapshot() const
+			{
+				return std::atomic_load(&t_);
+			}
+
+		/**
+		 * 整列済みのキー群から木を再構築して公開
+		 * @param[in]	begin	キー群の先頭
+		 * @param[in]	end	キー群の終端
+		 * @note	キー群の要件は @a PatriciaTrie::build_from_sorted と同じ。
+		 * @note	呼び出したスレッドで構築する。再構築中の時は終了を待ってから構築する。
+		 */
+		template<typename ITERATOR>
+		void
+		rebuild(ITERATOR begin,
+				ITERATOR end)
+			{
+				wait();
+
+				const Clock::time_point s = Clock::now();
+				std::unique_ptr<Trie> t(new Trie());
+				t->build_parallel(begin, end, p_);
+				const size_t keys = (size_t)std::distance(begin, end);
+				publish(t.release(), Elapsed(s), keys);
+			}
+
+		/**
+		 * 別のスレッドで木を再構築して公開
+		 * @param[in]	loader	キー群を読み込む関数 (引数は @a Entry の配列, false を返すと失敗)
+		 * @return	true: 再構築を開始した, false: 再構築中
+		 * @note	読み込んだキー群は整列してから構築するので、順序は問わない。
+		 *			同じキーが複数ある時は最後の値を採用する。
+		 * @note	失敗した時は公開中の木を変更せず、計測値の失敗の回数を増やす。
+		 */
+		template<typename LOADER>
+		bool
+		rebuild_async(LOADER loader)
+			{
+				if (busy_.load(std::memory_order_acquire)) return false;
+				if (w_.joinable()) w_.join();
+
+				busy_.store(true, std::memory_order_release);
+				w_ = std::thread([this, loader]() mutable {
+						try {
+							const Clock::time_point s = Clock::now();
+							std::vector<Entry> e;
+							if (loader(e)) {
+								std::stable_sort(e.begin(), e.end(), Less);
+								std::unique_ptr<Trie> t(new Trie());
+								t->build_parallel(e.begin(), e.end(), p_);
+								const size_t keys = e.size();
+								std::vector<Entry>().swap(e);
+								publish(t.release(), Elapsed(s), keys);
+							}
+							else {
+								fail();
+							}
+						}
+						catch (...) {
+							fail();
+						}
+						busy_.store(false, std::memory_order_release);
+					});
+
+				return true;
+			}
+
+		/**
+		 * 再構築の終了を待つ
+		 */
+		void
+		wait()
+			{
+				if (w_.joinable()) w_.join();
+			}
+
+		/**
+		 * 再構築中か否か
+		 * @return	true: 再構築中, false: それ以外
+		 */
+		bool
+		busy() const
+			{
+				return busy_.load(std::memory_order_acquire);
+			}
+
+		/**
+		 * 参照を手放された解放待ちの木を解放
+		 * @return	解放待ちの木の数
+		 * @note	公開の度にも行う。
+		 */
+		size_t
+		reclaim()
+			{
+				std::lock_guard<std::mutex> lock(m_);
+				return reclaim_locked();
+			}
+
+		/**
+		 * 計測値を取得
+		 * @return	計測値
+		 */
+		Metrics
+		metrics() const
+			{
+				std::lock_guard<std::mutex> lock(m_);
+				return s_;
+			}
+
+		/**
+		 * キーを探索 (キーに対応する値を獲得)
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	キー @a key に対応する値
+		 * @note	キーが見つからなかった場合は @a INVALID が返却される。
+		 */
+		VTYPE
+		get_value(const KTYPE* key,
+				  LTYPE length) const
+			{
+				return snapshot()->get_value(key, length);
+			}
+
+		/**
+		 * キーを探索 (共通接頭辞探索, 接頭辞となるキーの値を全て獲得)
+		 * @param[in]	buffer	探索対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[out]	values	配列 @a buffer の接頭辞となるキーの全ての値 (短い順)
+		 * @note	テンプレートのパラメータ @a CODE は @a PatriciaTrie::get_values と同じ。
+		 */
+		template<typename CODE = Elements<KTYPE> >
+		void
+		get_values(const KTYPE* buffer,
+				   LTYPE length,
+				   std::vector<VTYPE>& values) const
+			{
+				snapshot()->template get_values<CODE>(buffer, length, values);
+			}
+
+		/**
+		 * キーを探索 (共通接頭辞探索, 接頭辞となるキーを順に訪問)
+		 * @param[in]	buffer	探索対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[in]	visitor	接頭辞となるキーが見つかる度に短い順に呼び出す関数 (引数は値・キーの長さ, false を返すと探索を中止)
+		 * @note	探索の間は同じスナップショットを参照する。
+		 * @note	テンプレートのパラメータ @a CODE は @a PatriciaTrie::get_values と同じ。
+		 */
+		template<typename CODE = Elements<KTYPE>, typename VISITOR>
+		void
+		get_values(const KTYPE* buffer,
+				   LTYPE length,
+				   VISITOR visitor) const
+			{
+				snapshot()->template get_values<CODE>(buffer, length, visitor);
+			}
+
+		/**
+		 * キーを探索 (キーの有無をチェック)
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	true: キーが見つかった, false: 見つからなかった
+		 */
+		bool
+		find_key(const KTYPE* key,
+				 LTYPE length) const
+			{
+				return get_value(key, length) != INVALID;
+			}
+
+		/**
+		 * 値 @a INVALID を取得
+		 * @return	値 @a INVALID
+		 */
+		static VTYPE
+		InvalidValue()
+			{
+				return INVALID;
+			}
+	};
+};
+
+#endif	// __SNAPSHOT_PATRICIA_TRIE_HPP__
@@ -0,0 +1,718 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	succinct_patricia_trie.hpp
+ * @brief	C++ template library of succinct (LOUDS) patricia trie.
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ */
+
+#ifndef	__SUCCINCT_PATRICIA_TRIE_HPP__
+#define	__SUCCINCT_PATRICIA_TRIE_HPP__	"succinct_patricia_trie.hpp"
+
+#include <cstdio>
+#include <cstdint>
+#include <cassert>
+#include <type_traits>
+#include <algorithm>
+#include <vector>
+#include "patricia_trie.hpp"
+#include "frozen_patricia_trie.hpp"
+
+namespace ys
+{
+	/**
+	 * 64ビットの語のビット演算
+	 * @note	GCC・Clang では組み込み関数を用い、それ以外ではビット毎に数える。
+	 */
+	class BitOps
+	{
+	public:
+
+		/**
+		 * 1のビットの数を取得
+		 * @param[in]	x	値
+		 * @return	1のビットの数
+		 */
+		static unsigned int
+		Popcount(uint64_t x)
+			{
+#if	defined(__GNUC__) || defined(__clang__)
+				return (unsigned int)__builtin_popcountll(x);
+#else
+				unsigned int c(0);
+				for (; x; x &= x - 1) ++c;
+				return c;
+#endif
+			}
+
+		/**
+		 * 最下位の1のビットの位置を取得
+		 * @param[in]	x	0以外の値
+		 * @return	ビットの位置
+		 */
+		static unsigned int
+		Ctz(uint64_t x)
+			{
+				assert(x);
+
+#if	defined(__GNUC__) || defined(__clang__)
+				return (unsigned int)__builtin_ctzll(x);
+#else
+				unsigned int i(0);
+				while (!(x & 1)) {
+					x >>= 1;
+					++i;
+				}
+				return i;
+#endif
+			}
+
+		/**
+		 * 最上位の1のビットより上の0のビットの数を取得
+		 * @param[in]	x	0以外の値
+		 * @return	0のビットの数
+		 */
+		static unsigned int
+		Clz(uint64_t x)
+			{
+				assert(x);
+
+#if	defined(__GNUC__) || defined(__clang__)
+				return (unsigned int)__builtin_clzll(x);
+#else
+				unsigned int i(0);
+				while (!(x & ((uint64_t)1 << 63))) {
+					x <<= 1;
+					++i;
+				}
+				return i;
+#endif
+			}
+	};
+
+	/**
+	 * 順位・選択を備えたビット列
+	 * @note	512ビットの塊毎に先頭までの1の数を、512個毎の1・0を含む塊の番号を保持する (ビット列の約 1/8 の追加領域)。
+	 * @note	@a push で末尾にビットを追加し、@a build の後に参照する。
+	 */
+	class BitVector
+	{
+	private:
+
+		enum {
+			WORDS = 8,	///< 塊毎の語の数
+			BLOCK = WORDS * 64,	///< 塊毎のビットの数
+			SAMPLE = 512	///< 選択の索引の間隔 (ビットの数)
+		};
+
+		std::vector<uint64_t> b_;	///< ビット列 (塊の単位に0で詰める)
+		std::vector<uint32_t> r_;	///< 各塊の先頭までの1の数 (末尾に全体の1の数)
+		std::vector<uint32_t> s1_;	///< @a SAMPLE 個毎の1を含む塊の番号
+		std::vector<uint32_t> s0_;	///< @a SAMPLE 個毎の0を含む塊の番号
+		size_t n_;	///< ビットの数
+
+		/**
+		 * 塊の先頭までの1または0の数を取得
+		 * @param[in]	j	塊の番号
+		 * @return	数
+		 */
+		template<bool ONE>
+		size_t
+		count(size_t j) const
+			{
+				return ONE ? (size_t)r_[j] : j * BLOCK - (size_t)r_[j];
+			}
+
+		/**
+		 * 語の中で @a k 番目の1の位置を取得
+		 * @param[in]	x	語
+		 * @param[in]	k	1の順位 (0から, 語の1の数未満)
+		 * @return	位置
+		 */
+		static unsigned int
+		Select(uint64_t x,
+			   size_t k)
+			{
+				for (; 0 < k; --k) x &= x - 1;
+				return BitOps::Ctz(x);
+			}
+
+		/**
+		 * @a k 番目の1または0の位置を取得
+		 * @param[in]	k	順位 (0から)
+		 * @return	位置
+		 */
+		template<bool ONE>
+		size_t
+		select(size_t k) const
+			{
+				const std::vector<uint32_t>& s = ONE ? s1_ : s0_;
+				size_t j = s[k / SAMPLE];
+				while (count<ONE>(j + 1) <= k) ++j;
+				k -= count<ONE>(j);
+
+				for (size_t w = j * WORDS; ; ++w) {
+					const uint64_t x = ONE ? b_[w] : ~b_[w];
+					const size_t c = (size_t)BitOps::Popcount(x);
+					if (k < c) return w * 64 + Select(x, k);
+					k -= c;
+				}
+			}
+
+		/**
+		 * 位置 @a i 以降の最初の1または0の位置を取得
+		 * @param[in]	i	位置
+		 * @return	位置 (見つからなかった時はビットの数)
+		 */
+		template<bool ONE>
+		size_t
+		next(size_t i) const
+			{
+				size_t w = i / 64;
+				if (b_.size() <= w) return n_;
+
+				uint64_t x = (ONE ? b_[w] : ~b_[w]) >> (i % 64);
+				if (x) return std::min(n_, i + (size_t)BitOps::Ctz(x));
+
+				for (++w; w < b_.size(); ++w) {
+					x = ONE ? b_[w] : ~b_[w];
+					if (x) return std::min(n_, w * 64 + (size_t)BitOps::Ctz(x));
+				}
+
+				return n_;
+			}
+
+	public:
+
+		/**
+		 * コンストラクタ
+		 */
+		BitVector()
+			: b_(), r_(), s1_(), s0_(), n_(0)
+			{
+				;
+			}
+
+		/**
+		 * ビットを末尾に追加
+		 * @param[in]	bit	ビット
+		 */
+		void
+		push(bool bit)
+			{
+				if (n_ % 64 == 0) b_.push_back(0);
+				if (bit) b_.back() |= (uint64_t)1 << (n_ % 64);
+				++n_;
+			}
+
+		/**
+		 * 順位・選択の索引を構築
+		 * @note	以後は @a push しないこと。
+		 */
+		void
+		build()
+			{
+				b_.resize((b_.size() + WORDS - 1) / WORDS * WORDS, 0);
+				b_.shrink_to_fit();
+
+				const size_t blocks = b_.size() / WORDS;
+				r_.assign(blocks + 1, 0);
+				s1_.clear();
+				s0_.clear();
+
+				size_t c1(0);
+				size_t c0(0);
+				for (size_t j(0); j < blocks; ++j) {
+					r_[j] = (uint32_t)c1;
+					size_t c(0);
+					for (size_t w(0); w < WORDS; ++w) c += (size_t)BitOps::Popcount(b_[j * WORDS + w]);
+
+					// 塊の中に順位が SAMPLE の倍数となるビットがあれば記録
+					for (; s1_.size() * SAMPLE < c1 + c; ) s1_.push_back((uint32_t)j);
+					for (; s0_.size() * SAMPLE < c0 + BLOCK - c; ) s0_.push_back((uint32_t)j);
+					c1 += c;
+					c0 += BLOCK - c;
+				}
+				r_[blocks] = (uint32_t)c1;
+				if (s1_.empty()) s1_.push_back(0);
+				if (s0_.empty()) s0_.push_back(0);
+			}
+
+		/**
+		 * ビットを取得
+		 * @param[in]	i	位置
+		 * @return	ビット
+		 */
+		bool
+		get(size_t i) const
+			{
+				assert(i < n_);
+
+				return (b_[i / 64] >> (i % 64)) & 1;
+			}
+
+		/**
+		 * 順位を取得
+		 * @param[in]	i	位置 (ビットの数以下)
+		 * @return	位置 @a i より前の1の数
+		 */
+		size_t
+		rank1(size_t i) const
+			{
+				assert(i <= n_);
+
+				const size_t q = i / 64;
+				size_t r = r_[i / BLOCK];
+				for (size_t w = i / BLOCK * WORDS; w < q; ++w) r += (size_t)BitOps::Popcount(b_[w]);
+				if (i % 64) r += (size_t)BitOps::Popcount(b_[q] & (((uint64_t)1 << (i % 64)) - 1));
+
+				return r;
+			}
+
+		/**
+		 * @a k 番目の1の位置を取得
+		 * @param[in]	k	順位 (0から, 1の数未満)
+		 * @return	位置
+		 */
+		size_t
+		select1(size_t k) const
+			{
+				return select<true>(k);
+			}
+
+		/**
+		 * @a k 番目の0の位置を取得
+		 * @param[in]	k	順位 (0から, 0の数未満)
+		 * @return	位置
+		 */
+		size_t
+		select0(size_t k) const
+			{
+				return select<false>(k);
+			}
+
+		/**
+		 * 位置 @a i 以降の最初の1の位置を取得
+		 * @param[in]	i	位置
+		 * @return	位置 (見つからなかった時はビットの数)
+		 */
+		size_t
+		next1(size_t i) const
+			{
+				return next<true>(i);
+			}
+
+		/**
+		 * 位置 @a i 以降の最初の0の位置を取得
+		 * @param[in]	i	位置
+		 * @return	位置 (見つからなかった時はビットの数)
+		 */
+		size_t
+		next0(size_t i) const
+			{
+				return next<false>(i);
+			}
+
+		/**
+		 * ビットの数を取得
+		 * @return	ビットの数
+		 */
+		size_t
+		size() const
+			{
+				return n_;
+			}
+
+		/**
+		 * 使用している領域の大きさを取得
+		 * @return	バイト数
+		 */
+		size_t
+		bytes() const
+			{
+				return sizeof(uint64_t) * b_.size() + sizeof(uint32_t) * (r_.size() + s1_.size() + s0_.size());
+			}
+	};
+
+	/**
+	 * 固定のビット幅に詰めた整数の配列
+	 * @note	ビット幅は格納する値の最大値から定める (0の時は領域を持たない)。
+	 */
+	class PackedArray
+	{
+	private:
+
+		std::vector<uint64_t> b_;	///< 詰めた値 (末尾に1語の余白)
+		unsigned int w_;	///< ビット幅
+
+	public:
+
+		/**
+		 * コンストラクタ
+		 */
+		PackedArray()
+			: b_(), w_(0)
+			{
+				;
+			}
+
+		/**
+		 * 値を詰めて格納
+		 * @param[in]	values	値
+		 */
+		void
+		assign(const std::vector<uint64_t>& values)
+			{
+				uint64_t m(0);
+				for (uint64_t v : values) m |= v;
+				w_ = m ? 64 - BitOps::Clz(m) : 0;
+
+				b_.assign(w_ ? (values.size() * w_ + 63) / 64 + 1 : 0, 0);
+				b_.shrink_to_fit();
+				for (size_t i(0); i < values.size() && 0 < w_; ++i) {
+					const size_t p = i * w_;
+					b_[p / 64] |= values[i] << (p % 64);
+					if (64 < p % 64 + w_) b_[p / 64 + 1] |= values[i] >> (64 - p % 64);
+				}
+			}
+
+		/**
+		 * 値を取得
+		 * @param[in]	i	添字
+		 * @return	値
+		 */
+		uint64_t
+		get(size_t i) const
+			{
+				if (w_ == 0) return 0;
+
+				const size_t p = i * w_;
+				uint64_t v = b_[p / 64] >> (p % 64);
+				if (64 < p % 64 + w_) v |= b_[p / 64 + 1] << (64 - p % 64);
+
+				return w_ < 64 ? v & (((uint64_t)1 << w_) - 1) : v;
+			}
+
+		/**
+		 * 使用している領域の大きさを取得
+		 * @return	バイト数
+		 */
+		size_t
+		bytes() const
+			{
+				return sizeof(uint64_t) * b_.size();
+			}
+	};
+
+	/**
+	 * 簡潔表現のパトリシア木 (読み出し専用)
+	 * @note	@a FrozenPatriciaTrie と同じ幅優先順のノードを、次のビット列・配列で表す。
+	 *			- 木の形 (LOUDS): ノード毎に子ノードの数だけの1と、区切りの0。
+	 *			- キー末端の有無 (ノード毎に1ビット) と、キー末端の値 (最大値のビット幅に詰めた配列)。
+	 *			- キーの全体 (間に挟まる要素) の有無 (ノード毎に1ビット) と、キーの全体を連結した配列・その先頭の印 (要素毎に1ビット)。
+	 *			- 各ノードに至るキーの値の配列。
+	 * @note	ノード @a x の子ノードは、@a x 番目 (0から) の区切りの0の直後から並ぶ1に対応し、
+	 *			先頭の子ノードの添字はその位置から @a x を引いて1を足したものになる。
+	 * @note	ノード毎の管理情報はビット数程度で、@a FrozenPatriciaTrie のノード (24バイト以上) の
+	 *			数分の1の領域で済むが、探索の各段で順位・選択の計算を要する。
+	 * @note	テンプレートのパラメータは @a PatriciaTrie と同じ。
+	 */
+	template<typename KTYPE, typename LTYPE, typename VTYPE, VTYPE INVALID = ~(VTYPE)0>
+	class SuccinctPatriciaTrie
+	{
+	private:
+
+		typedef typename std::make_unsigned<KTYPE>::type UTYPE;	///< キーの比較に用いる型
+
+		BitVector t_;	///< 木の形 (LOUDS)
+		BitVector f_;	///< キー末端の有無
+		BitVector g_;	///< キーの全体の有無
+		BitVector e_;	///< キーの全体の先頭の印 (配列 @a d_ と同じ添字)
+		std::vector<KTYPE> s_;	///< 各ノードに至るキーの値
+		std::vector<KTYPE> d_;	///< 各ノードのキーの全体を連結したもの
+		PackedArray v_;	///< キー末端の値 (幅優先順)
+		size_t n_;	///< ノードの数
+		size_t k_;	///< キー末端の数
+
+		/**
+		 * 子ノードを探索
+		 * @param[in]	x	親ノードの添字
+		 * @param[in]	k	子ノードに至るキーの値
+		 * @return	子ノードの添字 (見つからなかった時は0)
+		 */
+		size_t
+		child(size_t x,
+			  KTYPE k) const
+			{
+				const size_t p = x ? t_.select0(x - 1) + 1 : 0;	// 子ノードに対応する1の先頭
+				const size_t c = p - x + 1;	// 先頭の子ノードの添字
+				size_t i(0);
+				size_t j = t_.next0(p) - p;
+
+				if (j <= 8) {
+					for (; i < j; ++i) {
+						if (s_[c + i] == k) return c + i;
+					}
+					return 0;
+				}
+
+				const KTYPE* s = s_.data() + c;
+				const size_t n = j;
+				while (i < j) {
+					size_t m = (i + j) / 2;
+					if ((UTYPE)s[m] < (UTYPE)k) i = m + 1;
+					else j = m;
+				}
+
+				return (i < n && s[i] == k) ? c + i : 0;
+			}
+
+		/**
+		 * ノードのキーの全体を取得
+		 * @param[in]	x	ノードの添字
+		 * @param[out]	l	キーの全体の長さ
+		 * @return	キーの全体の先頭 (配列 @a d_ 内)
+		 */
+		const KTYPE*
+		label(size_t x,
+			  size_t& l) const
+			{
+				if (!g_.get(x)) {
+					l = 0;
+					return d_.data();
+				}
+
+				const size_t p = e_.select1(g_.rank1(x));
+				l = e_.next1(p + 1) - p;
+				return d_.data() + p;
+			}
+
+		/**
+		 * ノードのキー末端を取得
+		 * @param[in]	x	ノードの添字
+		 * @return	値 (非末端の時は @a INVALID)
+		 */
+		VTYPE
+		value(size_t x) const
+			{
+				return f_.get(x) ? (VTYPE)v_.get(f_.rank1(x)) : INVALID;
+			}
+
+	public:
+
+		/**
+		 * コンストラクタ
+		 * @param[in]	frozen	変換する凍結したパトリシア木
+		 */
+		explicit
+		SuccinctPatriciaTrie(const FrozenPatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID>& frozen)
+			: t_(), f_(), g_(), e_(), s_(), d_(), v_(), n_(frozen.n_), k_(0)
+			{
+				std::vector<uint64_t> values;
+
+				s_.reserve(n_);
+				d_.reserve(frozen.m_);
+
+				for (size_t x(0); x < n_; ++x) {
+					const auto& r = frozen.r_[x];
+					assert(r.n == 0 || r.c == t_.size() - x + 1);
+
+					for (uint32_t i(0); i < r.n; ++i) t_.push(true);
+					t_.push(false);
+
+					f_.push(r.v != INVALID);
+					if (r.v != INVALID) values.push_back((uint64_t)r.v);
+
+					g_.push(0 < r.l);
+					for (uint32_t i(0); i < r.l; ++i) {
+						e_.push(i == 0);
+						d_.push_back(frozen.d_[r.d + i]);
+					}
+
+					s_.push_back(frozen.s_[x]);
+				}
+
+				t_.build();
+				f_.build();
+				g_.build();
+				e_.build();
+				v_.assign(values);
+				k_ = values.size();
+			}
+
+		/**
+		 * コンストラクタ
+		 * @param[in]	trie	変換するパトリシア木
+		 * @note	一旦 @a FrozenPatriciaTrie に凍結してから変換する。
+		 */
+		template<typename ALLOCATOR, typename COUNTER>
+		explicit
+		SuccinctPatriciaTrie(const PatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID, ALLOCATOR, COUNTER>& trie)
+			: SuccinctPatriciaTrie(FrozenPatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID>(trie))
+			{
+				;
+			}
+
+		/**
+		 * コピー・コンストラクタ (使用禁止)
+		 */
+		SuccinctPatriciaTrie(const SuccinctPatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID>&) = delete;
+
+		/**
+		 * 代入演算子 (使用禁止)
+		 */
+		SuccinctPatriciaTrie&
+		operator =(const SuccinctPatriciaTrie<KTYPE, LTYPE, VTYPE, INVALID>&) = delete;
+
+		/**
+		 * デストラクタ
+		 */
+		virtual
+		~SuccinctPatriciaTrie()
+			{
+				;
+			}
+
+		/**
+		 * キーを探索 (キーに対応する値を獲得)
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	キー @a key に対応する値
+		 * @note	キーが見つからなかった場合は @a INVALID が返却される。
+		 */
+		VTYPE
+		get_value(const KTYPE* key,
+				  LTYPE length) const
+			{
+				assert(key);
+				assert(0 < length);
+
+				size_t x = child(0, key[0]);
+				if (!x) return INVALID;
+				LTYPE i(1);
+
+				for (;;) {
+					size_t l;
+					const KTYPE* d = label(x, l);
+					if ((size_t)(length - i) < l) return INVALID;
+					if (Symbols<KTYPE>::Mismatch(d, key + i, (LTYPE)l) != (LTYPE)l) return INVALID;
+					i += (LTYPE)l;
+					if (i == length) return value(x);
+
+					x = child(x, key[i]);
+					if (!x) return INVALID;
+					++i;
+				}
+			}
+
+		/**
+		 * キーを探索 (共通接頭辞探索, 接頭辞となるキーの値を全て獲得)
+		 * @param[in]	buffer	探索対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[out]	values	配列 @a buffer の接頭辞となるキーの全ての値 (短い順)
+		 * @note	テンプレートのパラメータ @a CODE は @a PatriciaTrie::get_values と同じ。
+		 */
+		template<typename CODE = Elements<KTYPE> >
+		void
+		get_values(const KTYPE* buffer,
+				   LTYPE length,
+				   std::vector<VTYPE>& values) const
+			{
+				get_values<CODE>(buffer, length, [&values](VTYPE v, LTYPE) { values.push_back(v); return true; });
+			}
+
+		/**
+		 * キーを探索 (共通接頭辞探索, 接頭辞となるキーを順に訪問)
+		 * @param[in]	buffer	探索対象のデータ
+		 * @param[in]	length	配列 @a buffer の要素数
+		 * @param[in]	visitor	接頭辞となるキーが見つかる度に短い順に呼び出す関数 (引数は値・キーの長さ, false を返すと探索を中止)
+		 * @note	領域を確保しない。
+		 * @note	テンプレートのパラメータ @a CODE は @a PatriciaTrie::get_values と同じ。
+		 */
+		template<typename CODE = Elements<KTYPE>, typename VISITOR>
+		void
+		get_values(const KTYPE* buffer,
+				   LTYPE length,
+				   VISITOR visitor) const
+			{
+				assert(buffer);
+				assert(0 < length);
+
+				size_t x = child(0, buffer[0]);
+				if (!x) return;
+				LTYPE i(1);
+
+				for (;;) {
+					size_t l;
+					const KTYPE* d = label(x, l);
+					if ((size_t)(length - i) < l) return;
+					if (Symbols<KTYPE>::Mismatch(d, buffer + i, (LTYPE)l) != (LTYPE)l) return;
+					i += (LTYPE)l;
+					if (f_.get(x) && CODE::Boundary(buffer, (size_t)length, (size_t)i) && !visitor(value(x), i)) return;
+					if (i == length) return;
+
+					x = child(x, buffer[i]);
+					if (!x) return;
+					++i;
+				}
+			}
+
+		/**
+		 * キーを探索 (キーの有無をチェック)
+		 * @param[in]	key	キー
+		 * @param[in]	length	配列 @a key の要素数
+		 * @return	true: キーが見つかった, false: 見つからなかった
+		 */
+		bool
+		find_key(const KTYPE* key,
+				 LTYPE length) const
+			{
+				assert(key);
+				assert(0 < length);
+
+				return get_value(key, length) != INVALID;
+			}
+
+		/**
+		 * ノードの数を取得
+		 * @return	ノードの数 (根を含む)
+		 */
+		size_t
+		node_count() const
+			{
+				return n_;
+			}
+
+		/**
+		 * キーの数を取得
+		 * @return	キーの数
+		 */
+		size_t
+		size() const
+			{
+				return k_;
+			}
+
+		/**
+		 * 使用している領域の大きさを取得
+		 * @return	ビット列・索引・配列のバイト数
+		 */
+		size_t
+		bytes() const
+			{
+				return t_.bytes() + f_.bytes() + g_.bytes() + e_.bytes() + v_.bytes()
+					+ sizeof(KTYPE) * (s_.capacity() + d_.capacity());
+			}
+
+		/**
+		 * 値 @a INVALID を取得
+		 * @return	値 @a INVALID
+		 */
+		static VTYPE
+		InvalidValue()
+			{
+				return INVALID;
+			}
+	};
+};
+
+#endif	// __SUCCINCT_PATRICIA_TRIE_HPP__
@@ -0,0 +1,267 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	test_bit.cpp
+ * @brief	BitPatriciaTrie のテスト (総当たりの経路表との最長一致の照合)
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+#include "bit_patricia_trie.hpp"
+#include "test_util.hpp"
+
+/**
+ * 総当たりで探索する経路表
+ */
+template<typename KTYPE>
+class Table
+{
+private:
+
+	typedef ys::BitKey<KTYPE> TRAITS;	///< キーの方針
+
+	std::map<std::pair<KTYPE, unsigned int>, unsigned int> m_;	///< (接頭辞, 接頭辞長) から値への表
+
+public:
+
+	/**
+	 * コンストラクタ
+	 */
+	Table()
+		: m_()
+		{
+			;
+		}
+
+	/**
+	 * 経路を追加
+	 * @param[in]	key	接頭辞
+	 * @param[in]	length	接頭辞長
+	 * @param[in]	value	値
+	 */
+	void
+	add(KTYPE key,
+		unsigned int length,
+		unsigned int value)
+		{
+			m_[std::make_pair(TRAITS::Mask(key, length), length)] = value;
+		}
+
+	/**
+	 * 経路を削除
+	 * @param[in]	key	接頭辞
+	 * @param[in]	length	接頭辞長
+	 * @return	値 (見つからなかった時は @a INVALID に相当する ~0)
+	 */
+	unsigned int
+	remove(KTYPE key,
+		   unsigned int length)
+		{
+			auto it = m_.find(std::make_pair(TRAITS::Mask(key, length), length));
+			if (it == m_.end()) return ~0U;
+			const unsigned int v = it->second;
+			m_.erase(it);
+			return v;
+		}
+
+	/**
+	 * 経路の値を取得
+	 * @param[in]	key	接頭辞
+	 * @param[in]	length	接頭辞長
+	 * @return	値 (見つからなかった時は @a INVALID に相当する ~0)
+	 */
+	unsigned int
+	get(KTYPE key,
+		unsigned int length) const
+		{
+			auto it = m_.find(std::make_pair(TRAITS::Mask(key, length), length));
+			return it == m_.end() ? ~0U : it->second;
+		}
+
+	/**
+	 * アドレスに一致する経路を短い順に取得
+	 * @param[in]	key	アドレス
+	 * @return	(値, 接頭辞長) の列
+	 */
+	std::vector<std::pair<unsigned int, unsigned int> >
+	match(KTYPE key) const
+		{
+			std::vector<std::pair<unsigned int, unsigned int> > r;
+			for (unsigned int l(0); l <= TRAITS::Bits(); ++l) {
+				auto it = m_.find(std::make_pair(TRAITS::Mask(key, l), l));
+				if (it != m_.end()) r.push_back(std::make_pair(it->second, l));
+			}
+			return r;
+		}
+
+	/**
+	 * 経路の数を取得
+	 * @return	経路の数
+	 */
+	size_t
+	size() const
+		{
+			return m_.size();
+		}
+};
+
+/**
+ * 乱数で整数のキーを生成
+ * @param[in,out]	g	乱数の生成器
+ * @return	キー
+ */
+template<typename KTYPE>
+static KTYPE
+Random(std::mt19937_64& g)
+{
+	KTYPE k(0);
+	for (size_t i(0); i < sizeof(KTYPE); ++i) k = (KTYPE)((k << 4 << 4) | (KTYPE)(g() & 0xFF));
+	return k;
+}
+
+/**
+ * 無作為な経路の追加・削除と最長一致を総当たりの経路表と照合
+ * @param[in]	seed	乱数の種
+ * @note	キーは少数の基底の先頭を残して変えたものとし、接頭辞の包含・分岐・統合を多く起こす。
+ *			/0 とキーのビット数の接頭辞も含める。
+ */
+template<typename KTYPE>
+static void
+TestRandom(uint32_t seed)
+{
+	typedef ys::BitPatriciaTrie<KTYPE, unsigned int> Trie;
+	typedef ys::BitKey<KTYPE> TRAITS;
+
+	const unsigned int bits = TRAITS::Bits();
+	std::mt19937_64 g(seed);
+	std::vector<KTYPE> bases;
+	for (int i(0); i < 4; ++i) bases.push_back(Random<KTYPE>(g));
+
+	// 経路の候補 (先頭・末尾の接頭辞長を多めに含める)
+	std::vector<std::pair<KTYPE, unsigned int> > routes;
+	for (int i(0); i < 400; ++i) {
+		const unsigned int l = i % 8 == 0 ? 0 : i % 8 == 1 ? bits : (unsigned int)(g() % (bits + 1));
+		const unsigned int d = (unsigned int)(g() % (bits + 1));	// 基底から変えるビットの位置
+		KTYPE k = bases[g() % bases.size()];
+		if (d < bits) k = (KTYPE)(TRAITS::Mask(k, d) | (Random<KTYPE>(g) & (KTYPE)~TRAITS::Mask((KTYPE)~(KTYPE)0, d)));
+		routes.push_back(std::make_pair(k, l));
+	}
+
+	Trie trie;
+	Table<KTYPE> table;
+
+	auto compare = [&]() {
+		TEST_CHECK(trie.size() == table.size());
+		for (size_t i(0); i < routes.size() + 200; ++i) {
+			// 経路の接頭辞を共有するアドレスと無作為なアドレス
+			KTYPE a = i < routes.size() ? (KTYPE)(routes[i].first | (Random<KTYPE>(g) & (KTYPE)~TRAITS::Mask((KTYPE)~(KTYPE)0, routes[i].second))) : Random<KTYPE>(g);
+			const auto m = table.match(a);
+
+			unsigned int l(~0U);
+			const unsigned int v = trie.get_longest_prefix(a, &l);
+			TEST_CHECK(m.empty() ? (v == Trie::InvalidValue() && l == ~0U) : (v == m.back().first && l == m.back().second));
+
+			std::vector<std::pair<unsigned int, unsigned int> > r;
+			trie.get_values(a, [&](unsigned int x, unsigned int y) {
+					r.push_back(std::make_pair(x, y));
+					return true;
+				});
+			TEST_CHECK(r == m);
+
+			if (i < routes.size()) {
+				const unsigned int e = table.get(routes[i].first, routes[i].second);
+				TEST_CHECK(trie.find_key(routes[i].first, routes[i].second) == (e != ~0U));
+				TEST_CHECK(trie.get_value(a, routes[i].second) == e);
+			}
+		}
+	};
+
+	for (size_t r(0); r < 3000; ++r) {
+		const auto& k = routes[g() % routes.size()];
+		if (g() % 5 < 2) {
+			// 接頭辞長以降のビットは無視する
+			const KTYPE noisy = (KTYPE)(k.first | (Random<KTYPE>(g) & (KTYPE)~TRAITS::Mask((KTYPE)~(KTYPE)0, k.second)));
+			TEST_CHECK(trie.remove_key(noisy, k.second) == table.remove(k.first, k.second));
+		}
+		else {
+			trie.add_key(k.first, k.second, (unsigned int)r);
+			table.add(k.first, k.second, (unsigned int)r);
+		}
+		if (r % 500 == 0) compare();
+	}
+	compare();
+
+	// 全て削除すると何も一致しない
+	for (const auto& k : routes) TEST_CHECK(trie.remove_key(k.first, k.second) == table.remove(k.first, k.second));
+	TEST_CHECK(trie.size() == 0);
+	compare();
+}
+
+/**
+ * 既定経路・ホスト経路と、削除による統合の具体例を確認
+ */
+static void
+TestRoutes()
+{
+	typedef ys::BitPatriciaTrie<uint32_t, unsigned int> Trie;
+
+	const uint32_t a10 = 0x0A000000U;	// 10.0.0.0
+	Trie trie;
+
+	TEST_CHECK(trie.get_longest_prefix(a10) == Trie::InvalidValue());
+
+	trie.add_key(0, 0, 1);	// 0.0.0.0/0
+	trie.add_key(a10, 8, 2);	// 10.0.0.0/8
+	trie.add_key(0x0A010000U, 16, 3);	// 10.1.0.0/16
+	trie.add_key(0x0A800000U, 9, 4);	// 10.128.0.0/9 (10.0.0.0/8 の下で分岐)
+	trie.add_key(0x0A010203U, 32, 5);	// 10.1.2.3/32
+
+	unsigned int l(0);
+	TEST_CHECK(trie.get_longest_prefix(0xC0A80001U, &l) == 1 && l == 0);
+	TEST_CHECK(trie.get_longest_prefix(0x0A020000U, &l) == 2 && l == 8);
+	TEST_CHECK(trie.get_longest_prefix(0x0A010204U, &l) == 3 && l == 16);
+	TEST_CHECK(trie.get_longest_prefix(0x0A010203U, &l) == 5 && l == 32);
+	TEST_CHECK(trie.get_longest_prefix(0x0AFF0000U, &l) == 4 && l == 9);
+	TEST_CHECK(trie.size() == 5);
+
+	// 子ノードを2つ持つ経路の削除は非末端ノードを残す
+	TEST_CHECK(trie.remove_key(a10, 8) == 2);
+	TEST_CHECK(trie.get_longest_prefix(0x0A020000U, &l) == 1 && l == 0);
+	TEST_CHECK(trie.get_longest_prefix(0x0AFF0000U, &l) == 4 && l == 9);
+
+	// 葉の削除で非末端の親ノードを統合する
+	TEST_CHECK(trie.remove_key(0x0A800000U, 9) == 4);
+	TEST_CHECK(trie.get_longest_prefix(0x0AFF0000U, &l) == 1 && l == 0);
+	TEST_CHECK(trie.get_longest_prefix(0x0A010203U, &l) == 5 && l == 32);
+	TEST_CHECK(!trie.find_key(a10, 8));
+
+	// 子ノードが1つの経路の削除
+	TEST_CHECK(trie.remove_key(0x0A010000U, 16) == 3);
+	TEST_CHECK(trie.get_longest_prefix(0x0A010204U, &l) == 1 && l == 0);
+	TEST_CHECK(trie.get_longest_prefix(0x0A010203U, &l) == 5 && l == 32);
+
+	TEST_CHECK(trie.remove_key(0, 0) == 1);
+	TEST_CHECK(trie.remove_key(0, 0) == Trie::InvalidValue());
+	TEST_CHECK(trie.get_longest_prefix(0x0A010204U) == Trie::InvalidValue());
+	TEST_CHECK(trie.get_value(0x0A010203U, 32) == 5 && trie.size() == 1);
+}
+
+/**
+ * テスト・コマンド
+ */
+int main()
+{
+	TestRoutes();
+	TestRandom<uint8_t>(1);
+	TestRandom<uint32_t>(2);
+	TestRandom<uint64_t>(3);
+#if	defined(__SIZEOF_INT128__)
+	TestRandom<unsigned __int128>(4);
+#endif
+
+	return test::Finish("bit_patricia_trie");
+}
@@ -0,0 +1,158 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	test_concurrent.cpp
+ * @brief	ConcurrentPatriciaTrie のテスト (std::map との照合, 追加・削除と探索の並行実行)
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ */
+
+#include <cstdio>
+#include <atomic>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "concurrent_patricia_trie.hpp"
+#include "test_util.hpp"
+
+typedef ys::ConcurrentPatriciaTrie<char, unsigned int, unsigned int> Trie;
+
+/**
+ * 全てのキーの探索結果を std::map と照合
+ * @param[in]	trie	木
+ * @param[in]	map	期待する内容
+ * @param[in]	keys	探索するキー群
+ */
+static void
+Compare(const Trie& trie,
+		const std::map<std::string, unsigned int>& map,
+		const std::vector<std::string>& keys)
+{
+	for (const auto& k : keys) {
+		const auto it = map.find(k);
+		const unsigned int v = trie.get_value(k.data(), (unsigned int)k.size());
+		TEST_CHECK(v == (it == map.end() ? Trie::InvalidValue() : it->second));
+		TEST_CHECK(trie.find_key(k.data(), (unsigned int)k.size()) == (it != map.end()));
+
+		// 接頭辞となるキーの値は短い順に並ぶ
+		std::vector<unsigned int> expected;
+		for (size_t l(1); l <= k.size(); ++l) {
+			const auto jt = map.find(k.substr(0, l));
+			if (jt != map.end()) expected.push_back(jt->second);
+		}
+		std::vector<unsigned int> values;
+		trie.get_values(k.data(), (unsigned int)k.size(), values);
+		TEST_CHECK(values == expected);
+	}
+}
+
+/**
+ * 単一のスレッドで無作為な追加・削除を std::map と照合
+ */
+static void
+TestSequential()
+{
+	const std::vector<std::string> keys = test::Keys(3000, 3, 8, 1);
+	std::mt19937 g(2);
+	Trie trie;
+	std::map<std::string, unsigned int> map;
+
+	for (size_t r(0); r < 20000; ++r) {
+		const std::string& k = keys[g() % keys.size()];
+		if (g() % 3 == 0) {
+			const auto it = map.find(k);
+			const unsigned int v = trie.remove_key(k.data(), (unsigned int)k.size());
+			TEST_CHECK(v == (it == map.end() ? Trie::InvalidValue() : it->second));
+			if (it != map.end()) map.erase(it);
+		}
+		else {
+			const unsigned int v = (unsigned int)r;
+			trie.add_key(k.data(), (unsigned int)k.size(), v);
+			map[k] = v;
+		}
+
+		if (r % 2000 == 0) Compare(trie, map, keys);
+	}
+	Compare(trie, map, keys);
+
+	// 全て削除すると空になる
+	for (const auto& k : keys) trie.remove_key(k.data(), (unsigned int)k.size());
+	map.clear();
+	Compare(trie, map, keys);
+}
+
+/**
+ * 1つの書き込みスレッドの追加・削除と複数の読み出しスレッドの探索を並行に実行
+ * @note	値はキーから定まるので、読み出しスレッドは見つかった値が探索したキーと矛盾しないことを確かめる。
+ *			常に登録されているキー群は、いつ探索しても見つかること。
+ */
+static void
+TestConcurrent()
+{
+	const std::vector<std::string> keys = test::Keys(2000, 3, 7, 3);
+	std::vector<std::string> pinned;
+	for (size_t i(0); i < keys.size(); i += 10) pinned.push_back(keys[i] + "z");
+
+	Trie trie;
+	for (const auto& k : pinned) trie.add_key(k.data(), (unsigned int)k.size(), test::Value(k));
+
+	std::atomic<bool> done(false);
+	std::vector<std::thread> readers;
+	for (unsigned int t(0); t < 3; ++t) {
+		readers.push_back(std::thread([&, t]() {
+					std::mt19937 g(100 + t);
+					std::vector<unsigned int> values;
+					while (!done.load(std::memory_order_relaxed)) {
+						const std::string& k = keys[g() % keys.size()];
+						const unsigned int v = trie.get_value(k.data(), (unsigned int)k.size());
+						TEST_CHECK(v == Trie::InvalidValue() || v == test::Value(k));
+
+						const std::string& p = pinned[g() % pinned.size()];
+						TEST_CHECK(trie.get_value(p.data(), (unsigned int)p.size()) == test::Value(p));
+
+						// 接頭辞となるキーの値は、いずれかの接頭辞の値と一致する
+						values.clear();
+						trie.get_values(p.data(), (unsigned int)p.size(), values);
+						TEST_CHECK(!values.empty() && values.back() == test::Value(p));
+						for (auto x : values) {
+							bool found(false);
+							for (size_t l(1); l <= p.size() && !found; ++l) found = x == test::Value(p.substr(0, l));
+							TEST_CHECK(found);
+						}
+					}
+				}));
+	}
+
+	std::mt19937 g(4);
+	std::map<std::string, unsigned int> map;
+	for (const auto& k : pinned) map[k] = test::Value(k);
+
+	for (size_t r(0); r < 30000; ++r) {
+		const std::string& k = keys[g() % keys.size()];
+		if (g() % 2 == 0) {
+			trie.remove_key(k.data(), (unsigned int)k.size());
+			map.erase(k);
+		}
+		else {
+			trie.add_key(k.data(), (unsigned int)k.size(), test::Value(k));
+			map[k] = test::Value(k);
+		}
+	}
+
+	done.store(true);
+	for (auto& t : readers) t.join();
+
+	Compare(trie, map, keys);
+	Compare(trie, map, pinned);
+}
+
+/**
+ * テスト・コマンド
+ */
+int main()
+{
+	TestSequential();
+	TestConcurrent();
+
+	return test::Finish("concurrent_patricia_trie");
+}
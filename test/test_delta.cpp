@@ -0,0 +1,215 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	test_delta.cpp
+ * @brief	DeltaPatriciaTrie のテスト (追加・削除・凍結・圧縮・読み込みの std::map との照合)
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ */
+
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "delta_patricia_trie.hpp"
+#include "test_util.hpp"
+
+typedef ys::DeltaPatriciaTrie<char, unsigned int, unsigned int> Trie;
+
+/**
+ * 圧縮したファイルのパス (make test は木の最上位で実行する)
+ */
+static const char* const PATH = "test/test_delta.img";
+
+/**
+ * 接頭辞となるキーの値を std::map から取得
+ * @param[in]	map	期待する内容
+ * @param[in]	k	キー
+ * @return	値 (短い順)
+ */
+static std::vector<unsigned int>
+Prefixes(const std::map<std::string, unsigned int>& map,
+		 const std::string& k)
+{
+	std::vector<unsigned int> r;
+	for (size_t l(1); l <= k.size(); ++l) {
+		const auto it = map.find(k.substr(0, l));
+		if (it != map.end()) r.push_back(it->second);
+	}
+	return r;
+}
+
+/**
+ * 全てのキーの探索結果を std::map と照合
+ * @param[in]	trie	木
+ * @param[in]	map	期待する内容
+ * @param[in]	keys	探索するキー群
+ */
+static void
+Compare(const Trie& trie,
+		const std::map<std::string, unsigned int>& map,
+		const std::vector<std::string>& keys)
+{
+	for (const auto& k : keys) {
+		const auto it = map.find(k);
+		TEST_CHECK(trie.get_value(k.data(), (unsigned int)k.size()) == (it == map.end() ? Trie::InvalidValue() : it->second));
+		TEST_CHECK(trie.find_key(k.data(), (unsigned int)k.size()) == (it != map.end()));
+
+		const std::vector<unsigned int> expected = Prefixes(map, k);
+		std::vector<unsigned int> values;
+		trie.get_values(k.data(), (unsigned int)k.size(), values);
+		TEST_CHECK(values == expected);
+
+		// 訪問関数は長さを添えて短い順に呼ばれ、false で止まる
+		std::vector<unsigned int> lengths;
+		values.clear();
+		trie.get_values(k.data(), (unsigned int)k.size(), [&](unsigned int v, unsigned int l) {
+				TEST_CHECK(map.count(k.substr(0, l)) == 1 && map.find(k.substr(0, l))->second == v);
+				TEST_CHECK(lengths.empty() || lengths.back() < l);
+				lengths.push_back(l);
+				values.push_back(v);
+				return values.size() < 2;
+			});
+		TEST_CHECK(values.size() == std::min((size_t)2, expected.size()));
+	}
+}
+
+/**
+ * 無作為な追加・削除に凍結・圧縮・読み込みを挟んで std::map と照合
+ * @param[in]	seed	乱数の種
+ * @note	基底・凍結した差分・差分のそれぞれにある同じキーの追加・削除 (墓標) を重ねる。
+ */
+static void
+TestRandom(uint32_t seed)
+{
+	const std::vector<std::string> keys = test::Keys(1500, 3, 7, seed);
+	std::mt19937 g(seed + 1);
+	Trie trie;
+	std::map<std::string, unsigned int> map;
+
+	for (size_t r(0); r < 20000; ++r) {
+		const std::string& k = keys[g() % keys.size()];
+		const unsigned int c = g() % 1000;
+
+		if (c < 350) {
+			const auto it = map.find(k);
+			TEST_CHECK(trie.remove_key(k.data(), (unsigned int)k.size()) == (it == map.end() ? Trie::InvalidValue() : it->second));
+			if (it != map.end()) map.erase(it);
+		}
+		else if (c < 990) {
+			trie.add_key(k.data(), (unsigned int)k.size(), (unsigned int)r);
+			map[k] = (unsigned int)r;
+		}
+		else if (c < 995) {
+			const bool sealed = trie.sealed();
+			TEST_CHECK(trie.seal() == !sealed);
+			TEST_CHECK(trie.sealed());
+		}
+		else if (trie.sealed()) {
+			// 圧縮しても読み込むまでは内容が変わらない
+			TEST_CHECK(trie.compact(PATH));
+			Compare(trie, map, keys);
+			TEST_CHECK(trie.open_mapped(PATH));
+			TEST_CHECK(!trie.sealed());
+		}
+
+		if (r % 2000 == 0) Compare(trie, map, keys);
+	}
+	Compare(trie, map, keys);
+
+	// 最後に全てを基底に移す
+	if (!trie.sealed()) trie.seal();
+	TEST_CHECK(trie.compact(PATH));
+	TEST_CHECK(trie.open_mapped(PATH));
+	TEST_CHECK(trie.seal());
+	TEST_CHECK(trie.compact(PATH));
+	TEST_CHECK(trie.open_mapped(PATH));
+	Compare(trie, map, keys);
+
+	// 基底のキー数は std::map と一致する
+	size_t n(0);
+	trie.base().for_each([&](const char*, unsigned int, unsigned int) { ++n; return true; });
+	TEST_CHECK(n == map.size());
+}
+
+/**
+ * 層をまたぐ置き換え・削除・再追加と、多数の接頭辞の併合を確認
+ */
+static void
+TestLayers()
+{
+	Trie trie;
+	std::map<std::string, unsigned int> map;
+	std::vector<std::string> keys;
+
+	// 基底に長い連鎖 (SPAN を超える接頭辞) を置く
+	std::string s;
+	for (unsigned int i(0); i < 40; ++i) {
+		s.push_back((char)('a' + i % 3));
+		keys.push_back(s);
+		trie.add_key(s.data(), (unsigned int)s.size(), i);
+		map[s] = i;
+	}
+	TEST_CHECK(trie.seal());
+	TEST_CHECK(trie.compact(PATH));
+	TEST_CHECK(trie.open_mapped(PATH));
+	Compare(trie, map, keys);
+
+	// 凍結した差分で奇数番目を置き換え、3の倍数番目を削除
+	for (unsigned int i(0); i < 40; ++i) {
+		const std::string& k = keys[i];
+		if (i % 3 == 0) {
+			TEST_CHECK(trie.remove_key(k.data(), (unsigned int)k.size()) == map[k]);
+			map.erase(k);
+		}
+		else if (i % 2 == 1) {
+			trie.add_key(k.data(), (unsigned int)k.size(), 100 + i);
+			map[k] = 100 + i;
+		}
+	}
+	TEST_CHECK(trie.seal());
+	Compare(trie, map, keys);
+
+	// 差分で削除したキーの一部を再追加し、凍結した差分で置き換えたキーを削除
+	for (unsigned int i(0); i < 40; ++i) {
+		const std::string& k = keys[i];
+		if (i % 6 == 0) {
+			trie.add_key(k.data(), (unsigned int)k.size(), 200 + i);
+			map[k] = 200 + i;
+		}
+		else if (i % 5 == 1) {
+			const auto it = map.find(k);
+			TEST_CHECK(trie.remove_key(k.data(), (unsigned int)k.size()) == (it == map.end() ? Trie::InvalidValue() : it->second));
+			if (it != map.end()) map.erase(it);
+		}
+	}
+	// 削除済みのキーの削除は何もしない
+	TEST_CHECK(trie.remove_key(keys[3].data(), (unsigned int)keys[3].size()) == Trie::InvalidValue());
+	TEST_CHECK(!trie.seal());
+	Compare(trie, map, keys);
+
+	// 圧縮は差分を含まないが、読み込み後も差分は残る
+	TEST_CHECK(trie.compact(PATH));
+	TEST_CHECK(trie.open_mapped(PATH));
+	Compare(trie, map, keys);
+	TEST_CHECK(trie.seal());
+	TEST_CHECK(trie.compact(PATH));
+	TEST_CHECK(trie.open_mapped(PATH));
+	Compare(trie, map, keys);
+
+	// 読み込みに失敗しても内容は変わらない
+	TEST_CHECK(!trie.open_mapped("test/no_such_file.img"));
+	Compare(trie, map, keys);
+}
+
+/**
+ * テスト・コマンド
+ */
+int main()
+{
+	TestLayers();
+	TestRandom(1);
+	TestRandom(2);
+	std::remove(PATH);
+
+	return test::Finish("delta_patricia_trie");
+}
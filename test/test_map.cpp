@@ -0,0 +1,296 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	test_map.cpp
+ * @brief	PatriciaMap のテスト (ムーブのみ可能な値, 置き換え, 例外時の状態)
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ */
+
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "patricia_map.hpp"
+#include "test_util.hpp"
+
+/**
+ * 指定した回数の後に確保に失敗するアロケータ
+ */
+class FailingAllocator : public ys::HeapAllocator
+{
+public:
+
+	/**
+	 * 失敗までの確保の回数を取得
+	 * @return	回数 (負の時は失敗しない)
+	 */
+	static long&
+	Countdown()
+		{
+			static long n(-1);
+			return n;
+		}
+
+	/**
+	 * 領域を確保
+	 * @param[in]	size	バイト数
+	 * @return	領域
+	 */
+	void*
+	allocate(size_t size)
+		{
+			long& n = Countdown();
+			if (n == 0) throw std::bad_alloc();
+			if (0 < n) --n;
+			return ys::HeapAllocator::allocate(size);
+		}
+};
+
+/**
+ * 構築の回数と生存数を数える値
+ * @note	@a Fail が真の時は構築に失敗する。
+ */
+class Counted
+{
+private:
+
+	int v_;	///< 値
+
+public:
+
+	/**
+	 * 構築に失敗するか否かを取得
+	 * @return	構築に失敗するか否か
+	 */
+	static bool&
+	Fail()
+		{
+			static bool f(false);
+			return f;
+		}
+
+	/**
+	 * 生存している値の数を取得
+	 * @return	値の数
+	 */
+	static long&
+	Live()
+		{
+			static long n(0);
+			return n;
+		}
+
+	/**
+	 * コンストラクタ
+	 * @param[in]	v	値
+	 */
+	explicit
+	Counted(int v)
+		: v_(v)
+		{
+			if (Fail()) throw std::runtime_error("Counted");
+			++Live();
+		}
+
+	/**
+	 * コピー・コンストラクタ
+	 * @param[in]	other	複製元
+	 */
+	Counted(const Counted& other)
+		: v_(other.v_)
+		{
+			if (Fail()) throw std::runtime_error("Counted");
+			++Live();
+		}
+
+	/**
+	 * 代入演算子 (使用禁止)
+	 */
+	Counted&
+	operator =(const Counted&) = delete;
+
+	/**
+	 * デストラクタ
+	 */
+	~Counted()
+		{
+			--Live();
+		}
+
+	/**
+	 * 値を取得
+	 * @return	値
+	 */
+	int
+	get() const
+		{
+			return v_;
+		}
+};
+
+/**
+ * ムーブのみ可能な値を std::map と照合
+ */
+static void
+TestUniquePtr()
+{
+	typedef ys::PatriciaMap<char, unsigned int, std::unique_ptr<std::string> > Map;
+
+	const std::vector<std::string> keys = test::Keys(3000, 3, 8, 1);
+	std::mt19937 g(2);
+	Map map;
+	std::map<std::string, std::string> ref;
+
+	for (size_t r(0); r < 20000; ++r) {
+		const std::string& k = keys[g() % keys.size()];
+		if (g() % 3 == 0) {
+			TEST_CHECK(map.remove_key(k.data(), (unsigned int)k.size()) == (ref.erase(k) == 1));
+		}
+		else {
+			const std::string v = k + "/" + std::to_string(r);
+			std::unique_ptr<std::string>& p = r % 2 == 0
+				? map.add_key(k.data(), (unsigned int)k.size(), std::unique_ptr<std::string>(new std::string(v)))
+				: map.emplace(k.data(), (unsigned int)k.size(), new std::string(v));
+			TEST_CHECK(p && *p == v);
+			ref[k] = v;
+		}
+	}
+
+	TEST_CHECK(map.size() == ref.size());
+	for (const auto& k : keys) {
+		const auto it = ref.find(k);
+		const std::unique_ptr<std::string>* p = map.get_value(k.data(), (unsigned int)k.size());
+		TEST_CHECK(map.find_key(k.data(), (unsigned int)k.size()) == (it != ref.end()));
+		TEST_CHECK(it == ref.end() ? !p : (p && **p == it->second));
+
+		// 接頭辞となるキーの値は短い順に訪問する
+		std::vector<std::string> expected;
+		for (size_t l(1); l <= k.size(); ++l) {
+			const auto jt = ref.find(k.substr(0, l));
+			if (jt != ref.end()) expected.push_back(jt->second);
+		}
+		std::vector<std::string> values;
+		map.get_values(k.data(), (unsigned int)k.size(), [&](const std::unique_ptr<std::string>& v, unsigned int l) {
+				TEST_CHECK(v->compare(0, l, k, 0, l) == 0);
+				values.push_back(*v);
+				return true;
+			});
+		TEST_CHECK(values == expected);
+	}
+}
+
+/**
+ * 置き換え・削除で値を過不足なく破棄し、その他の値の参照を保つことを確認
+ */
+static void
+TestReplace()
+{
+	typedef ys::PatriciaMap<char, unsigned int, Counted> Map;
+
+	{
+		Map map;
+		const Counted& a = map.emplace("abc", 3, 1);
+		const Counted& b = map.emplace("ab", 2, 2);
+		TEST_CHECK(Counted::Live() == 2);
+
+		// 置き換えは古い値を破棄し、数は変わらない
+		TEST_CHECK(map.emplace("ab", 2, 3).get() == 3);
+		TEST_CHECK(Counted::Live() == 2 && map.size() == 2);
+		TEST_CHECK(map.get_value("ab", 2)->get() == 3);
+		TEST_CHECK(&a == map.get_value("abc", 3) && a.get() == 1);
+		(void)b;
+
+		// 塊をまたいで追加しても既存の値は再配置しない
+		for (int i(0); i < 5000; ++i) {
+			const std::string k = "k" + std::to_string(i);
+			map.emplace(k.data(), (unsigned int)k.size(), i);
+		}
+		TEST_CHECK(&a == map.get_value("abc", 3) && a.get() == 1);
+		TEST_CHECK(Counted::Live() == 5002 && map.size() == 5002);
+
+		TEST_CHECK(map.remove_key("abc", 3));
+		TEST_CHECK(!map.remove_key("abc", 3));
+		TEST_CHECK(!map.get_value("abc", 3));
+		TEST_CHECK(Counted::Live() == 5001 && map.size() == 5001);
+	}
+
+	// 破棄時に残った値を全て破棄する
+	TEST_CHECK(Counted::Live() == 0);
+}
+
+/**
+ * 値の構築・木への追加が例外で失敗しても、状態が変わらないことを確認
+ */
+static void
+TestExceptions()
+{
+	typedef ys::PatriciaMap<char, unsigned int, Counted, FailingAllocator> Map;
+
+	{
+		Map map;
+		map.emplace("ab", 2, 1);
+
+		// 値の構築の失敗 (新規・置き換え)
+		Counted::Fail() = true;
+		bool thrown(false);
+		try {
+			map.emplace("abc", 3, 2);
+		}
+		catch (const std::runtime_error&) {
+			thrown = true;
+		}
+		TEST_CHECK(thrown);
+
+		thrown = false;
+		try {
+			map.emplace("ab", 2, 3);
+		}
+		catch (const std::runtime_error&) {
+			thrown = true;
+		}
+		TEST_CHECK(thrown);
+		Counted::Fail() = false;
+
+		TEST_CHECK(map.size() == 1 && Counted::Live() == 1);
+		TEST_CHECK(!map.find_key("abc", 3));
+		TEST_CHECK(map.get_value("ab", 2)->get() == 1);
+
+		// 木への追加の失敗 (分岐のノードを確保できない)
+		FailingAllocator::Countdown() = 0;
+		thrown = false;
+		try {
+			map.emplace("ax", 2, 4);
+		}
+		catch (const std::bad_alloc&) {
+			thrown = true;
+		}
+		FailingAllocator::Countdown() = -1;
+		TEST_CHECK(thrown);
+		TEST_CHECK(map.size() == 1 && Counted::Live() == 1);
+		TEST_CHECK(!map.find_key("ax", 2));
+		TEST_CHECK(map.get_value("ab", 2)->get() == 1);
+
+		// 失敗後に解放した番号を再利用できる
+		TEST_CHECK(map.emplace("abc", 3, 5).get() == 5);
+		TEST_CHECK(map.emplace("ax", 2, 6).get() == 6);
+		TEST_CHECK(map.size() == 3 && Counted::Live() == 3);
+		TEST_CHECK(map.get_value("ab", 2)->get() == 1);
+	}
+
+	TEST_CHECK(Counted::Live() == 0);
+}
+
+/**
+ * テスト・コマンド
+ */
+int main()
+{
+	TestUniquePtr();
+	TestReplace();
+	TestExceptions();
+
+	return test::Finish("patricia_map");
+}
@@ -0,0 +1,196 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	test_sharded.cpp
+ * @brief	ShardedPatriciaTrie, ReadWriteLock のテスト (std::map との照合, 複数のスレッドからの更新・探索)
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ */
+
+#include <cstdio>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "sharded_patricia_trie.hpp"
+#include "test_util.hpp"
+
+typedef ys::ShardedPatriciaTrie<char, unsigned int, unsigned int> Trie;
+
+/**
+ * 全てのキーの探索結果を std::map と照合
+ * @param[in]	trie	木
+ * @param[in]	map	期待する内容
+ * @param[in]	keys	探索するキー群
+ */
+static void
+Compare(const Trie& trie,
+		const std::map<std::string, unsigned int>& map,
+		const std::vector<std::string>& keys)
+{
+	for (const auto& k : keys) {
+		const auto it = map.find(k);
+		TEST_CHECK(trie.get_value(k.data(), (unsigned int)k.size()) == (it == map.end() ? Trie::InvalidValue() : it->second));
+		TEST_CHECK(trie.find_key(k.data(), (unsigned int)k.size()) == (it != map.end()));
+
+		// 接頭辞となるキーの値は短い順に並ぶ (先頭の値の分割をまたぐ)
+		std::vector<unsigned int> expected;
+		for (size_t l(1); l <= k.size(); ++l) {
+			const auto jt = map.find(k.substr(0, l));
+			if (jt != map.end()) expected.push_back(jt->second);
+		}
+		std::vector<unsigned int> values;
+		trie.get_values(k.data(), (unsigned int)k.size(), values);
+		TEST_CHECK(values == expected);
+	}
+}
+
+/**
+ * 単一のスレッドで無作為な追加・削除を std::map と照合
+ * @param[in]	shards	分割の数
+ * @param[in]	prefix	振り分けに用いるキーの先頭の要素数
+ */
+static void
+TestSequential(size_t shards,
+			   unsigned int prefix)
+{
+	const std::vector<std::string> keys = test::Keys(2000, 3, 8, (uint32_t)(shards * 10 + prefix));
+	std::mt19937 g(1);
+	Trie trie(shards, prefix);
+	std::map<std::string, unsigned int> map;
+
+	TEST_CHECK(trie.shard_count() == shards);
+
+	for (size_t r(0); r < 10000; ++r) {
+		const std::string& k = keys[g() % keys.size()];
+		if (g() % 3 == 0) {
+			const auto it = map.find(k);
+			TEST_CHECK(trie.remove_key(k.data(), (unsigned int)k.size()) == (it == map.end() ? Trie::InvalidValue() : it->second));
+			if (it != map.end()) map.erase(it);
+		}
+		else {
+			trie.add_key(k.data(), (unsigned int)k.size(), (unsigned int)r);
+			map[k] = (unsigned int)r;
+		}
+	}
+
+	Compare(trie, map, keys);
+}
+
+/**
+ * 読み書きロックの排他を確認
+ * @note	書き込みのロックの下で2つの変数を更新し、読み込みのロックの下では常に等しいことを確かめる。
+ *			排他が破れると ThreadSanitizer がデータ競合を報告する。
+ */
+static void
+TestLock()
+{
+	ys::ReadWriteLock m;
+	size_t a(0);
+	size_t b(0);
+	std::atomic<unsigned int> readers(0);
+	std::vector<std::thread> threads;
+
+	for (unsigned int t(0); t < 4; ++t) {
+		threads.push_back(std::thread([&, t]() {
+					for (size_t i(0); i < 2000; ++i) {
+						if (t % 2 == 0) {
+							std::lock_guard<ys::ReadWriteLock> lock(m);
+							TEST_CHECK(readers.load() == 0);
+							++a;
+							std::this_thread::yield();
+							++b;
+						}
+						else {
+							m.lock_shared();
+							readers.fetch_add(1);
+							TEST_CHECK(a == b);
+							readers.fetch_sub(1);
+							m.unlock_shared();
+						}
+					}
+				}));
+	}
+	for (auto& t : threads) t.join();
+
+	TEST_CHECK(a == 4000 && b == 4000);
+}
+
+/**
+ * 複数の書き込みスレッドの追加・削除と読み出しスレッドの探索を並行に実行
+ * @param[in]	prefix	振り分けに用いるキーの先頭の要素数
+ * @note	書き込みスレッドはキー群を分担し、値はキーから定める。
+ */
+static void
+TestConcurrent(unsigned int prefix)
+{
+	const std::vector<std::string> keys = test::Keys(3000, 3, 7, 5 + prefix);
+	const unsigned int writers(2);
+	Trie trie(8, prefix);
+
+	std::atomic<bool> done(false);
+	std::vector<std::thread> threads;
+	std::vector<std::map<std::string, unsigned int> > maps(writers);
+
+	for (unsigned int t(0); t < writers; ++t) {
+		threads.push_back(std::thread([&, t]() {
+					std::mt19937 g(10 + t);
+					for (size_t r(0); r < 10000; ++r) {
+						const std::string& k = keys[g() % keys.size()];
+						if (test::Value(k) % writers != t) continue;
+						if (g() % 2 == 0) {
+							trie.remove_key(k.data(), (unsigned int)k.size());
+							maps[t].erase(k);
+						}
+						else {
+							trie.add_key(k.data(), (unsigned int)k.size(), test::Value(k));
+							maps[t][k] = test::Value(k);
+						}
+					}
+				}));
+	}
+	for (unsigned int t(0); t < 2; ++t) {
+		threads.push_back(std::thread([&, t]() {
+					std::mt19937 g(20 + t);
+					std::vector<unsigned int> values;
+					while (!done.load(std::memory_order_relaxed)) {
+						const std::string& k = keys[g() % keys.size()];
+						const unsigned int v = trie.get_value(k.data(), (unsigned int)k.size());
+						TEST_CHECK(v == Trie::InvalidValue() || v == test::Value(k));
+
+						values.clear();
+						trie.get_values(k.data(), (unsigned int)k.size(), values);
+						for (auto x : values) {
+							bool found(false);
+							for (size_t l(1); l <= k.size() && !found; ++l) found = x == test::Value(k.substr(0, l));
+							TEST_CHECK(found);
+						}
+					}
+				}));
+	}
+
+	for (unsigned int t(0); t < writers; ++t) threads[t].join();
+	done.store(true);
+	for (size_t t(writers); t < threads.size(); ++t) threads[t].join();
+
+	std::map<std::string, unsigned int> map;
+	for (const auto& m : maps) map.insert(m.begin(), m.end());
+	Compare(trie, map, keys);
+}
+
+/**
+ * テスト・コマンド
+ */
+int main()
+{
+	TestSequential(1, 1);
+	TestSequential(16, 1);
+	TestSequential(7, 3);
+	TestSequential(16, 20);
+	TestLock();
+	TestConcurrent(1);
+	TestConcurrent(2);
+
+	return test::Finish("sharded_patricia_trie");
+}
@@ -0,0 +1,187 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	test_snapshot.cpp
+ * @brief	SnapshotPatriciaTrie のテスト (探索中の再構築・公開, 失敗の扱い, 解放待ちの木の解放, 計測値)
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ */
+
+#include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "snapshot_patricia_trie.hpp"
+#include "test_util.hpp"
+
+typedef ys::SnapshotPatriciaTrie<char, unsigned int, unsigned int> Trie;
+
+enum {
+	KEYS = 500	///< 1つの版のキーの数
+};
+
+/**
+ * 版 @a g のキー群を読み込む関数を作成
+ * @param[in]	keys	キー群 (重複なし)
+ * @param[in]	g	版 (1以上)
+ * @return	読み込む関数
+ * @note	値は版とキーの番号の組 (版 * @a KEYS + 番号) で、順序は逆順とする (整列を確かめるため)。
+ */
+static std::function<bool(std::vector<Trie::Entry>&)>
+Loader(const std::vector<std::string>& keys,
+	   unsigned int g)
+{
+	return [&keys, g](std::vector<Trie::Entry>& e) {
+		for (size_t i(keys.size()); 0 < i; --i) {
+			const std::string& k = keys[i - 1];
+			e.push_back(Trie::Entry(std::vector<char>(k.begin(), k.end()), g * KEYS + (unsigned int)(i - 1)));
+		}
+		return true;
+	};
+}
+
+/**
+ * 探索中に非同期の再構築を繰り返し、各スナップショットの一貫性と解放を確認
+ */
+static void
+TestAsync()
+{
+	std::vector<std::string> keys = test::Keys(KEYS * 4, 4, 8, 1);
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	keys.resize(KEYS);
+
+	Trie trie(2);
+	std::atomic<bool> done(false);
+	std::vector<std::thread> readers;
+
+	for (unsigned int t(0); t < 3; ++t) {
+		readers.push_back(std::thread([&, t]() {
+					std::mt19937 g(10 + t);
+					unsigned int seen(0);	// 観測した最新の版
+					while (!done.load(std::memory_order_relaxed)) {
+						// 1つのスナップショット内の値は全て同じ版
+						Trie::Snapshot s = trie.snapshot();
+						const size_t i = g() % KEYS;
+						const size_t j = g() % KEYS;
+						const unsigned int a = s->get_value(keys[i].data(), (unsigned int)keys[i].size());
+						const unsigned int b = s->get_value(keys[j].data(), (unsigned int)keys[j].size());
+						if (a == Trie::InvalidValue()) {
+							TEST_CHECK(b == Trie::InvalidValue() && seen == 0);
+							continue;
+						}
+						TEST_CHECK(a % KEYS == i && b % KEYS == j && a / KEYS == b / KEYS);
+
+						// 公開の順は探索から見ても戻らない
+						TEST_CHECK(seen <= a / KEYS);
+						seen = a / KEYS;
+						s.reset();
+
+						const unsigned int c = trie.get_value(keys[i].data(), (unsigned int)keys[i].size());
+						TEST_CHECK(c % KEYS == i && seen <= c / KEYS);
+
+						std::vector<unsigned int> values;
+						trie.get_values(keys[j].data(), (unsigned int)keys[j].size(), values);
+						TEST_CHECK(!values.empty() && values.back() % KEYS == j);
+					}
+				}));
+	}
+
+	// 版を1つずつ公開
+	const unsigned int builds(20);
+	for (unsigned int g(1); g <= builds; ++g) {
+		TEST_CHECK(trie.rebuild_async(Loader(keys, g)));
+		trie.wait();
+		TEST_CHECK(!trie.busy());
+		trie.reclaim();
+	}
+
+	done.store(true);
+	for (auto& t : readers) t.join();
+
+	// 探索を終えると解放待ちの木はなくなる
+	TEST_CHECK(trie.reclaim() == 0);
+	const Trie::Metrics m = trie.metrics();
+	TEST_CHECK(m.builds == builds && m.failures == 0);
+	TEST_CHECK(m.keys == KEYS && m.retired == 0);
+	TEST_CHECK(m.last_build <= m.max_build && m.max_build <= m.total_build);
+	TEST_CHECK(m.last_swap <= m.max_swap);
+	TEST_CHECK(trie.get_value(keys[0].data(), (unsigned int)keys[0].size()) == builds * KEYS);
+}
+
+/**
+ * 読み込みの失敗・例外は公開中の木を変えず、保持したスナップショットは解放されないことを確認
+ */
+static void
+TestFailures()
+{
+	Trie trie;
+	const std::vector<std::string> keys = {"a", "ab", "abc", "b"};
+
+	TEST_CHECK(trie.snapshot()->get_value("a", 1) == Trie::InvalidValue());
+
+	// 同期の再構築 (整列済み)
+	std::vector<Trie::Entry> e;
+	for (size_t i(0); i < keys.size(); ++i) e.push_back(Trie::Entry(std::vector<char>(keys[i].begin(), keys[i].end()), (unsigned int)i));
+	trie.rebuild(e.begin(), e.end());
+	TEST_CHECK(trie.get_value("ab", 2) == 1);
+
+	Trie::Snapshot held = trie.snapshot();
+
+	// 失敗 (false を返す・例外を投げる) しても公開中の木は変わらない
+	TEST_CHECK(trie.rebuild_async([](std::vector<Trie::Entry>& e) { e.push_back(Trie::Entry(std::vector<char>(1, 'x'), 9)); return false; }));
+	trie.wait();
+	TEST_CHECK(trie.rebuild_async([](std::vector<Trie::Entry>&) -> bool { throw std::runtime_error("loader"); }));
+	trie.wait();
+	TEST_CHECK(trie.snapshot() == held);
+	TEST_CHECK(!trie.find_key("x", 1));
+
+	Trie::Metrics m = trie.metrics();
+	TEST_CHECK(m.builds == 1 && m.failures == 2 && m.keys == keys.size());
+
+	// 再構築中は新たな再構築を受け付けない
+	std::atomic<bool> release(false);
+	TEST_CHECK(trie.rebuild_async([&release](std::vector<Trie::Entry>&) {
+				while (!release.load()) std::this_thread::yield();
+				return false;
+			}));
+	TEST_CHECK(trie.busy());
+	TEST_CHECK(!trie.rebuild_async(Loader(keys, 1)));
+	release.store(true);
+	trie.wait();
+	TEST_CHECK(!trie.busy() && trie.metrics().failures == 3);
+
+	// 同じキーが複数ある時は最後の値を採用する
+	TEST_CHECK(trie.rebuild_async([](std::vector<Trie::Entry>& e) {
+				e.push_back(Trie::Entry(std::vector<char>(1, 'b'), 1));
+				e.push_back(Trie::Entry(std::vector<char>(1, 'a'), 2));
+				e.push_back(Trie::Entry(std::vector<char>(1, 'b'), 3));
+				return true;
+			}));
+	trie.wait();
+	TEST_CHECK(trie.get_value("a", 1) == 2 && trie.get_value("b", 1) == 3);
+	TEST_CHECK(!trie.find_key("ab", 2));
+
+	// 保持したスナップショットは古い版のまま探索でき、手放すまで解放しない
+	TEST_CHECK(held->get_value("abc", 3) == 2);
+	TEST_CHECK(trie.reclaim() == 1 && trie.metrics().retired == 1);
+	held.reset();
+	TEST_CHECK(trie.reclaim() == 0 && trie.metrics().retired == 0);
+
+	m = trie.metrics();
+	TEST_CHECK(m.builds == 2 && m.failures == 3 && m.keys == 3);
+}
+
+/**
+ * テスト・コマンド
+ */
+int main()
+{
+	TestFailures();
+	TestAsync();
+
+	return test::Finish("snapshot_patricia_trie");
+}
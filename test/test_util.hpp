@@ -0,0 +1,116 @@
+/* -*- coding: utf-8; tab-width: 4 -*- */
+/**
+ * @file	test_util.hpp
+ * @brief	テスト用の共通処理
+ * @author	Yasutaka SHINDOH / 新堂 安孝
+ */
+
+#ifndef	__TEST_UTIL_HPP__
+#define	__TEST_UTIL_HPP__	"test_util.hpp"
+
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * 条件を検査 (偽の時は位置を出力して失敗を数える)
+ */
+#define	TEST_CHECK(c)	test::Check((c), #c, __FILE__, __LINE__)
+
+namespace test
+{
+	/**
+	 * 失敗の数を取得
+	 * @return	失敗の数 (複数のスレッドから数える)
+	 */
+	inline std::atomic<size_t>&
+	Failures()
+	{
+		static std::atomic<size_t> n(0);
+		return n;
+	}
+
+	/**
+	 * 条件を検査
+	 * @param[in]	c	条件
+	 * @param[in]	expression	条件の式
+	 * @param[in]	file	ファイル名
+	 * @param[in]	line	行番号
+	 * @return	条件 @a c
+	 * @note	出力は失敗の最初の20件まで。
+	 */
+	inline bool
+	Check(bool c,
+		  const char* expression,
+		  const char* file,
+		  int line)
+	{
+		if (!c && Failures().fetch_add(1) < 20) {
+			std::fprintf(stderr, "%s:%d: failed: %s\n", file, line, expression);
+		}
+		return c;
+	}
+
+	/**
+	 * 結果を出力
+	 * @param[in]	name	テストの名前
+	 * @return	終了コード (0: 成功, 1: 失敗)
+	 */
+	inline int
+	Finish(const char* name)
+	{
+		const size_t n = Failures().load();
+		if (n == 0) std::printf("%-40s ok\n", name);
+		else std::printf("%-40s %zu failures\n", name, n);
+		return n == 0 ? 0 : 1;
+	}
+
+	/**
+	 * 小さな字母から無作為なキー群を生成
+	 * @param[in]	n	キーの数
+	 * @param[in]	alphabet	字母の大きさ (1以上26以下)
+	 * @param[in]	width	キーの長さの上限
+	 * @param[in]	seed	乱数の種
+	 * @return	キー群 (重複を含む)
+	 * @note	字母を小さくして、接頭辞の共有・分岐・統合が多く起こるようにする。
+	 */
+	inline std::vector<std::string>
+	Keys(size_t n,
+		 unsigned int alphabet,
+		 size_t width,
+		 uint32_t seed)
+	{
+		std::mt19937 g(seed);
+		std::vector<std::string> keys;
+		keys.reserve(n);
+
+		for (size_t i(0); i < n; ++i) {
+			std::string k;
+			const size_t l = 1 + g() % width;
+			for (size_t j(0); j < l; ++j) k.push_back((char)('a' + g() % alphabet));
+			keys.push_back(k);
+		}
+
+		return keys;
+	}
+
+	/**
+	 * キーから値を計算
+	 * @param[in]	key	キー
+	 * @return	値 (上位ビットは0)
+	 * @note	並行なテストで、見つかった値がキーと矛盾しないことを確かめるのに用いる。
+	 */
+	inline unsigned int
+	Value(const std::string& key)
+	{
+		unsigned int h(2166136261u);
+		for (char c : key) h = (h ^ (unsigned char)c) * 16777619u;
+		return h >> 4;
+	}
+}
+
+#endif	// __TEST_UTIL_HPP__